@@ -0,0 +1,117 @@
+#ifndef ADAPTIVE_RATE_H
+#define ADAPTIVE_RATE_H
+
+#include <math.h>
+
+// ==========================================
+//        ADAPTIVE SAMPLING / LOW POWER
+// ==========================================
+// When nobody is watching, no relay is running and the readings are flat,
+// the loop drops to a slow cadence: fewer ADC/ultrasonic reads and fewer
+// broadcasts. Any change, new WS client, upcoming feed or relay activity
+// snaps it back to full rate. Pure logic (no Arduino calls), covered by
+// test/test_cadence.cpp.
+//
+// Note: WiFi modem sleep is not used. The board always runs the softAP
+// (WIFI_AP_STA) and the ESP32 only modem-sleeps in station-only mode, so
+// the radio stays on either way.
+
+// --- Cadence ---
+const unsigned long SAMPLE_FAST_MS = 200;
+const unsigned long SAMPLE_IDLE_MS = 2000;
+const unsigned long BROADCAST_FAST_MS = 1000;
+const unsigned long BROADCAST_IDLE_MS = 10000;
+const unsigned long IDLE_ENTRY_MS = 30000; // Must be stable this long first
+const long FEED_WAKE_SEC = 60;             // Full rate this close to a feed
+
+// --- Stability Thresholds (change that counts as "not stable") ---
+const float STABLE_LEVEL_CM = 1.0;
+const float STABLE_TDS_PPM = 10.0;
+const float STABLE_PH = 0.1;
+const float STABLE_TURBIDITY_V = 0.1;
+
+struct CadenceInputs {
+  float level;
+  float tds;
+  float ph;
+  float turbidity;
+  bool relaysBusy;  // Any relay on or queued, or feeder running
+  int clients;      // Connected WS clients
+  long secsToFeed;  // -1 if unknown / no schedule
+};
+
+struct CadenceState {
+  bool idle;
+  bool hasReference;
+  float refLevel, refTDS, refPH, refTurbidity;
+  unsigned long stableSince;
+  unsigned long lastUpdate;
+  unsigned long activeMs; // Time spent at full rate
+  unsigned long idleMs;   // Time spent at idle rate
+};
+
+CadenceState cadence = {false, false, 0, 0, 0, 0, 0, 0, 0, 0};
+
+// --- Helper Functions ---
+
+bool cadenceReadingsMoved(const CadenceState &st, const CadenceInputs &in) {
+  return fabsf(in.level - st.refLevel) > STABLE_LEVEL_CM ||
+         fabsf(in.tds - st.refTDS) > STABLE_TDS_PPM ||
+         fabsf(in.ph - st.refPH) > STABLE_PH ||
+         fabsf(in.turbidity - st.refTurbidity) > STABLE_TURBIDITY_V;
+}
+
+// Leave idle immediately and restart the stability timer.
+void cadenceWake(CadenceState &st, unsigned long now) {
+  st.idle = false;
+  st.stableSince = now;
+}
+
+// Feed one sample in. Returns true if the idle/active mode changed.
+bool cadenceUpdate(CadenceState &st, const CadenceInputs &in,
+                   unsigned long now) {
+  // Duty cycle accounting for the interval that just ended
+  if (st.lastUpdate != 0) {
+    if (st.idle)
+      st.idleMs += now - st.lastUpdate;
+    else
+      st.activeMs += now - st.lastUpdate;
+  }
+  st.lastUpdate = now;
+
+  bool wasIdle = st.idle;
+  bool moved = !st.hasReference || cadenceReadingsMoved(st, in);
+  if (moved) {
+    st.refLevel = in.level;
+    st.refTDS = in.tds;
+    st.refPH = in.ph;
+    st.refTurbidity = in.turbidity;
+    st.hasReference = true;
+  }
+
+  bool feedSoon = in.secsToFeed >= 0 && in.secsToFeed <= FEED_WAKE_SEC;
+  if (moved || in.relaysBusy || in.clients > 0 || feedSoon) {
+    cadenceWake(st, now);
+  } else if (!st.idle && now - st.stableSince >= IDLE_ENTRY_MS) {
+    st.idle = true;
+  }
+  return st.idle != wasIdle;
+}
+
+unsigned long cadenceSampleMs(const CadenceState &st) {
+  return st.idle ? SAMPLE_IDLE_MS : SAMPLE_FAST_MS;
+}
+
+unsigned long cadenceBroadcastMs(const CadenceState &st) {
+  return st.idle ? BROADCAST_IDLE_MS : BROADCAST_FAST_MS;
+}
+
+// Percentage of uptime spent at full rate
+int cadenceDutyPercent(const CadenceState &st) {
+  unsigned long total = st.activeMs + st.idleMs;
+  if (total == 0)
+    return 100;
+  return (int)((st.activeMs * 100.0) / total);
+}
+
+#endif // ADAPTIVE_RATE_H
@@ -0,0 +1,90 @@
+#ifndef API_SNAPSHOT_H
+#define API_SNAPSHOT_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <memory>
+
+// ==========================================
+//          CACHED REST API SNAPSHOTS
+// ==========================================
+// Each GET route serves an immutable, pre-serialized JSON body. The loop
+// swaps in a fresh snapshot at most once per control tick; requests only
+// grab a reference to the current one, so N pollers cost one
+// serialization and no per-request copies of the body.
+
+const unsigned long API_ACTIVE_MS = 30000; // A poll keeps fast rebuilds on
+
+struct ApiSnapshot {
+  String body;
+  String etag; // Quoted content hash
+};
+
+typedef std::shared_ptr<const ApiSnapshot> ApiSnapshotPtr;
+
+ApiSnapshotPtr apiState;     // /api/state
+ApiSnapshotPtr apiSettings;  // /api/settings
+ApiSnapshotPtr apiRelays;    // /api/relays
+ApiSnapshotPtr apiForensics; // /api/forensics
+
+volatile unsigned long apiLastPoll = 0;
+
+// --- Helper Functions ---
+
+bool apiPolledRecently() {
+  return apiLastPoll != 0 && millis() - apiLastPoll < API_ACTIVE_MS;
+}
+
+// FNV-1a, plenty for change detection
+uint32_t apiHash(const String &s) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < s.length(); i++) {
+    h ^= (uint8_t)s[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// Publish a new body. Readers in the web task keep the old one alive
+// until their response is done.
+void apiPublish(ApiSnapshotPtr &slot, String &body) {
+  std::shared_ptr<ApiSnapshot> snap = std::make_shared<ApiSnapshot>();
+  char tag[12];
+  snprintf(tag, sizeof(tag), "\"%08lx\"", (unsigned long)apiHash(body));
+  snap->etag = tag;
+  snap->body = std::move(body);
+  std::atomic_store(&slot, ApiSnapshotPtr(snap));
+}
+
+void apiSend(AsyncWebServerRequest *request, ApiSnapshotPtr &slot) {
+  apiLastPoll = millis();
+  ApiSnapshotPtr snap = std::atomic_load(&slot);
+  if (!snap) {
+    request->send(503, "application/json", "{\"error\":\"not ready\"}");
+    return;
+  }
+
+  if (request->hasHeader("If-None-Match") &&
+      request->header("If-None-Match") == snap->etag) {
+    AsyncWebServerResponse *response = request->beginResponse(304);
+    response->addHeader("ETag", snap->etag);
+    request->send(response);
+    return;
+  }
+
+  // Stream straight out of the shared snapshot
+  AsyncWebServerResponse *response = request->beginResponse(
+      "application/json", snap->body.length(),
+      [snap](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+        size_t n = snap->body.length() - index;
+        if (n > maxLen)
+          n = maxLen;
+        memcpy(buffer, snap->body.c_str() + index, n);
+        return n;
+      });
+  response->addHeader("ETag", snap->etag);
+  response->addHeader("Cache-Control", "no-cache");
+  request->send(response);
+}
+
+#endif // API_SNAPSHOT_H
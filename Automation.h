@@ -1,9 +1,14 @@
 #ifndef AUTOMATION_H
 #define AUTOMATION_H
 
+#include "Calibration.h"
+#include "Forensics.h"
+#include "LevelEstimator.h"
 #include "Pins.h"
+#include "PowerBudget.h"
 #include <Arduino.h>
 #include <ESP32Servo.h>
+#include <atomic>
 #include <time.h>
 
 // --- Constants & Thresholds ---
@@ -28,7 +33,7 @@ float currentTDS = 0;
 float currentPH = 0;
 float currentTurbidity = 0;
 
-bool autoMode = true; // false = Manual Override via Web
+bool autoMode = true; // false = Manual Override via Web. Written in loop()
 bool isFeeding = false;
 unsigned long feedStartTime = 0;
 
@@ -43,6 +48,11 @@ struct RelayControl {
 // 1: Fill, 2: TDS1, 3: TDS2, 4: pH Up, 5: pH Down, 6: Solenoid
 RelayControl relays[7];
 
+// Posted by the web task, applied by applyRelayRequests() in loop(), so
+// relays and the power scheduler are only ever touched from one task
+volatile bool autoModeWanted = true;
+std::atomic<bool> toggleWanted[7];
+
 // Default Settings (Can be updated via Web)
 const int MAX_FEED_TIMES = 5;
 int feedTimes[MAX_FEED_TIMES][2] = {{7, 0},
@@ -59,6 +69,15 @@ unsigned long lastFedMillis = 0; // Uptime when last fed
 
 // --- Helper Functions ---
 
+// Like getLocalTime(), but never waits for NTP (that blocks up to 5s
+// while the clock is unset, which would trip the stall watchdog)
+bool getTimeNow(struct tm *info) {
+  time_t now;
+  time(&now);
+  localtime_r(&now, info);
+  return info->tm_year > (2016 - 1900);
+}
+
 // Safe Relay Control with Debounce
 void setRelayState(int id, bool state) {
   if (id < 1 || id > 6)
@@ -73,13 +92,60 @@ void setRelayState(int id, bool state) {
     relays[id].lastToggle = millis();
     // Active LOW logic: ON = LOW, OFF = HIGH
     digitalWrite(relays[id].pin, state ? LOW : HIGH);
+    powerNoteSwitched(id, state, relays[id].lastToggle);
+    forensicsRelayOp(id, state);
+  }
+}
+
+// Budgeted Relay Control: turn-offs go straight through, turn-ons are
+// queued and granted by updateActuation() within the power budget.
+void requestRelayState(int id, bool state) {
+  if (id < 1 || id > 6)
+    return;
+
+  if (state) {
+    if (!relays[id].active)
+      powerRequestOn(id, millis());
+  } else {
+    powerCancel(id, millis());
+    setRelayState(id, false);
   }
 }
 
 void toggleRelay(int id) {
   if (id < 1 || id > 6)
     return;
-  setRelayState(id, !relays[id].active);
+  requestRelayState(id, !(relays[id].active || powerSlots[id].pending));
+}
+
+// Apply the mode change and manual toggles posted by the web task. Call
+// every loop(), before updateActuation(). Returns true if anything changed.
+bool applyRelayRequests() {
+  bool wanted = autoModeWanted;
+  bool changed = autoMode != wanted;
+  if (autoMode && !wanted) {
+    // Automation's queued turn-ons must not start after the operator
+    // took over
+    powerCancelAll(millis());
+  }
+  autoMode = wanted;
+
+  for (int i = 1; i <= 6; i++) {
+    // Only allow manual toggle if Auto Mode is OFF
+    if (toggleWanted[i].exchange(false) && !autoMode) {
+      toggleRelay(i);
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+// Grant at most one queued turn-on per call. Call every loop().
+void updateActuation() {
+  int id = powerPickNext(millis());
+  if (id != 0) {
+    setRelayState(id, true); // Stays queued if debounce rejects it
+  }
 }
 
 void setupActuators() {
@@ -106,62 +172,40 @@ void setupSensors() {
   pinMode(PIN_MANUAL_SWITCH, INPUT_PULLUP);
 }
 
+// Single ping; filtering happens in LevelEstimator.h
 float readUltrasonic() {
-  const int numReadings = 5;
-  float readings[numReadings];
-
-  // Take multiple readings
-  for (int i = 0; i < numReadings; i++) {
-    digitalWrite(PIN_TRIG, LOW);
-    delayMicroseconds(2);
-    digitalWrite(PIN_TRIG, HIGH);
-    delayMicroseconds(10);
-    digitalWrite(PIN_TRIG, LOW);
-
-    long duration = pulseIn(PIN_ECHO, HIGH, 30000); // 30ms timeout
-    if (duration == 0) {
-      readings[i] = 999; // Error/Timeout
-    } else {
-      readings[i] = duration * 0.0343 / 2;
-    }
-    delay(10); // Small delay between readings
-  }
-
-  // Sort the readings (Bubble Sort)
-  for (int i = 0; i < numReadings - 1; i++) {
-    for (int j = 0; j < numReadings - i - 1; j++) {
-      if (readings[j] > readings[j + 1]) {
-        float temp = readings[j];
-        readings[j] = readings[j + 1];
-        readings[j + 1] = temp;
-      }
-    }
-  }
-
-  // Get Median (middle element)
-  float medianDistance = readings[numReadings / 2];
-
-  // Debug Output
-  Serial.print("Ultra raw: [");
-  for (int i = 0; i < numReadings; i++) {
-    Serial.print(readings[i]);
-    if (i < numReadings - 1)
-      Serial.print(", ");
-  }
-  Serial.print("] -> Median: ");
-  Serial.println(medianDistance);
-
-  return medianDistance;
+  digitalWrite(PIN_TRIG, LOW);
+  delayMicroseconds(2);
+  digitalWrite(PIN_TRIG, HIGH);
+  delayMicroseconds(10);
+  digitalWrite(PIN_TRIG, LOW);
+
+  long duration = pulseIn(PIN_ECHO, HIGH, 30000); // 30ms timeout
+  if (duration == 0)
+    return 999; // Error/Timeout
+  return duration * 0.0343 / 2;
 }
 
+// Calibrated, temperature compensated (see Calibration.h)
 float readTDS() {
-  int raw = analogRead(PIN_TDS);
-  return map(raw, 0, 4095, 0, 1000); // Demo mapping
+  return convertTdsPpm(analogRead(PIN_TDS), tdsCurve, waterTempC10);
 }
 
 float readPH() {
-  int raw = analogRead(PIN_PH);
-  return map(raw, 0, 4095, 0, 1400) / 100.0; // Demo mapping
+  return convertPhMilli(analogRead(PIN_PH), phCurve, waterTempC10) / 1000.0;
+}
+
+// Calibration capture: average fresh samples rather than reuse the last
+// reading, which is a single noisy sample and up to 2 s old when idle
+const int CAL_CAPTURE_SAMPLES = 16;
+
+int readRawAveraged(int pin) {
+  long sum = 0;
+  for (int i = 0; i < CAL_CAPTURE_SAMPLES; i++) {
+    sum += analogRead(pin);
+    delayMicroseconds(500);
+  }
+  return (sum + CAL_CAPTURE_SAMPLES / 2) / CAL_CAPTURE_SAMPLES;
 }
 
 float readTurbidity() {
@@ -187,7 +231,7 @@ void updateFeeder() {
 
 void checkSchedule() {
   struct tm timeinfo;
-  if (!getLocalTime(&timeinfo)) {
+  if (!getTimeNow(&timeinfo)) {
     return;
   }
 
@@ -211,7 +255,7 @@ void checkSchedule() {
 
 long getSecondsToNextFeed() {
   struct tm timeinfo;
-  if (!getLocalTime(&timeinfo)) {
+  if (!getTimeNow(&timeinfo)) {
     return -1;
   }
 
@@ -238,7 +282,9 @@ long getSecondsToNextFeed() {
 }
 
 void updateSensors() {
-  currentDistance = readUltrasonic();
+  // Fill pump raises the surface, drain valve lowers it
+  currentDistance = levelUpdate(levelEst, readUltrasonic(), relays[1].active,
+                                relays[6].active, millis());
   currentTDS = readTDS();
   currentPH = readPH();
   currentTurbidity = readTurbidity();
@@ -249,52 +295,55 @@ void runAutomation() {
     return;
 
   // 1. Water Level Control
+  // No level (sensor fault or not read yet): never fill blind
   // Distance > HIGH (e.g. 30 > 25) -> Level Low -> Fill ON
-  if (currentDistance > LEVEL_HIGH_CM) {
-    setRelayState(1, true);
+  if (!levelEst.ready) {
+    requestRelayState(1, false);
+  } else if (currentDistance > LEVEL_HIGH_CM) {
+    requestRelayState(1, true);
   } else if (currentDistance < LEVEL_LOW_CM) {
-    setRelayState(1, false);
+    requestRelayState(1, false);
   }
 
   // 2. TDS Control (With Hysteresis)
   // Deadband: 50ppm
   if (currentTDS > TDS_HIGH) {
-    setRelayState(2, true); // Drain/Repl
-    setRelayState(3, false);
+    requestRelayState(2, true); // Drain/Repl
+    requestRelayState(3, false);
   } else if (currentTDS < (TDS_HIGH - 50) && currentTDS > (TDS_LOW + 50)) {
     // In "Safe Zone" - turn off both
-    setRelayState(2, false);
-    setRelayState(3, false);
+    requestRelayState(2, false);
+    requestRelayState(3, false);
   } else if (currentTDS < TDS_LOW) {
-    setRelayState(2, false);
-    setRelayState(3, true); // Add Minerals
+    requestRelayState(2, false);
+    requestRelayState(3, true); // Add Minerals
   }
 
   // 3. pH Control (With Hysteresis)
   // Deadband: 0.2 pH
   if (currentPH < PH_LOW) {
-    setRelayState(4, true); // pH Up
-    setRelayState(5, false);
+    requestRelayState(4, true); // pH Up
+    requestRelayState(5, false);
   } else if (currentPH > (PH_LOW + 0.2) && currentPH < (PH_HIGH - 0.2)) {
     // In "Safe Zone" - turn off both
-    setRelayState(4, false);
-    setRelayState(5, false);
+    requestRelayState(4, false);
+    requestRelayState(5, false);
   } else if (currentPH > PH_HIGH) {
-    setRelayState(4, false);
-    setRelayState(5, true); // pH Down
+    requestRelayState(4, false);
+    requestRelayState(5, true); // pH Down
   }
 
   // 4. Turbidity -> Solenoid
   // Add simple hysteresis for solenoid too
   if (currentTurbidity < 2.0) {
-    setRelayState(6, true); // Open Valve (Dirty)
+    requestRelayState(6, true); // Open Valve (Dirty)
   } else if (currentTurbidity > 2.5) {
     // Only turn off if significantly clear
     // Check Manual Switch first (Active LOW)
     if (digitalRead(PIN_MANUAL_SWITCH) == LOW) {
-      setRelayState(6, true);
+      requestRelayState(6, true);
     } else {
-      setRelayState(6, false);
+      requestRelayState(6, false);
     }
   }
 }
@@ -0,0 +1,312 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <stdint.h>
+
+// ==========================================
+//      CALIBRATED SENSOR CONVERSION
+// ==========================================
+// raw ADC -> mV (ESP32 ADC linearity table) -> temperature compensation
+// -> multi-point calibration curve -> ppm / milli-pH.
+// Everything at runtime is integer maths; the lookup tables are generated
+// at compile time. No Arduino calls; test/test_calibration.cpp checks it
+// against a double reference.
+//
+// There is no temperature probe on this board yet: the water temperature
+// is entered from the web page (default 25.0 C).
+
+// --- Compile-time Table Generation (C++11 friendly) ---
+template <int... I> struct IndexList {};
+template <int N, int... I>
+struct MakeIndexList : MakeIndexList<N - 1, N - 1, I...> {};
+template <int... I> struct MakeIndexList<0, I...> {
+  typedef IndexList<I...> type;
+};
+
+template <int N> struct Lut {
+  int32_t v[N];
+};
+
+template <class Gen, int... I>
+constexpr Lut<sizeof...(I)> makeLut(IndexList<I...>) {
+  return {{Gen::at(I)...}};
+}
+
+constexpr int32_t roundToInt(double x) {
+  return (int32_t)(x < 0 ? x - 0.5 : x + 0.5);
+}
+
+// --- ADC Linearity (mV at every 64th raw count) ---
+// Polynomial fit of the ESP32 ADC1 at 11dB attenuation. Voltages inside
+// the pipeline are in 1/16 mV, so near the top of the range (well under
+// 1 mV per count) whole millivolts don't throw counts away. Calibration
+// points are stored in whole mV.
+const int ADC_LUT_SHIFT = 6;
+const int ADC_LUT_SIZE = (4096 >> ADC_LUT_SHIFT) + 1;
+const int MV_FRAC_BITS = 4;
+
+struct AdcMvGen {
+  static constexpr double volts(double r) {
+    return -0.000000000000016 * r * r * r * r +
+           0.000000000118171 * r * r * r - 0.000000301211691 * r * r +
+           0.001109019271794 * r + 0.034143524634089;
+  }
+  // The last entry is the fit at 4096, one past the ADC range, so every
+  // segment spans exactly 64 counts
+  static constexpr int32_t at(int i) {
+    return roundToInt(volts(i << ADC_LUT_SHIFT) * (1000 << MV_FRAC_BITS));
+  }
+};
+
+constexpr Lut<ADC_LUT_SIZE> adcMvLut =
+    makeLut<AdcMvGen>(MakeIndexList<ADC_LUT_SIZE>::type());
+
+// --- Temperature Compensation (Q16 factor per whole degree, 0-50 C) ---
+const int TEMP_LUT_SIZE = 51;
+const int32_t Q16_ONE = 65536;
+
+// Conductivity rises ~2%/C, so scale the probe mV back to 25 C
+struct TdsTempGen {
+  static constexpr int32_t at(int t) {
+    return roundToInt(Q16_ONE / (1.0 + 0.02 * (t - 25)));
+  }
+};
+
+// Nernst slope is proportional to absolute temperature
+struct PhTempGen {
+  static constexpr int32_t at(int t) {
+    return roundToInt(Q16_ONE * 298.15 / (t + 273.15));
+  }
+};
+
+constexpr Lut<TEMP_LUT_SIZE> tdsTempLut =
+    makeLut<TdsTempGen>(MakeIndexList<TEMP_LUT_SIZE>::type());
+constexpr Lut<TEMP_LUT_SIZE> phTempLut =
+    makeLut<PhTempGen>(MakeIndexList<TEMP_LUT_SIZE>::type());
+
+// --- Calibration Curves ---
+const int CAL_MAX_POINTS = 4;
+const int32_t CAL_SAME_POINT_MV = 20; // Closer captures replace each other
+
+struct CalPoint {
+  int32_t mv;    // Probe voltage in mV (TDS: already compensated to 25 C)
+  int32_t value; // ppm or milli-pH (pH: 25 C equivalent)
+};
+
+// count 0 = default curve, 1 = default curve shifted through the point,
+// 2+ = piecewise linear through the points (sorted by mv).
+struct CalCurve {
+  uint8_t count;
+  CalPoint pts[CAL_MAX_POINTS];
+};
+
+// The default curves are linear in raw counts, like the old demo
+// mapping (map(raw, 0, 4095, 0, full scale)), so uncalibrated boards
+// read the same as before. See calDefault().
+const int32_t TDS_FULL_SCALE_PPM = 1000;
+const int32_t PH_FULL_SCALE_MILLI = 14000;
+
+// A single calibration point sets the gain for conductivity (one standard
+// fixes the cell constant, 0 mV stays 0 ppm) but the offset for pH (one
+// buffer corrects the electrode offset)
+enum CalSinglePoint { CAL_SINGLE_GAIN, CAL_SINGLE_OFFSET };
+
+const int16_t WATER_TEMP_DEFAULT_C10 = 250; // Tenths of a degree
+const int32_t PH_NEUTRAL_MILLI = 7000;      // Isopotential point
+
+// --- State Variables ---
+CalCurve tdsCurve = {0, {}};
+CalCurve phCurve = {0, {}};
+int16_t waterTempC10 = WATER_TEMP_DEFAULT_C10;
+
+// --- Helper Functions ---
+
+// Raw count to 1/16 mV
+int32_t adcToMv16(int raw) {
+  if (raw < 0)
+    raw = 0;
+  if (raw > 4095)
+    raw = 4095;
+  int i = raw >> ADC_LUT_SHIFT;
+  int32_t frac = raw & ((1 << ADC_LUT_SHIFT) - 1);
+  int32_t a = adcMvLut.v[i];
+  int32_t b = adcMvLut.v[i + 1];
+  return a + (((b - a) * frac + (1 << (ADC_LUT_SHIFT - 1))) >> ADC_LUT_SHIFT);
+}
+
+int32_t mv16ToMv(int32_t mv16) {
+  return (mv16 + (1 << (MV_FRAC_BITS - 1))) >> MV_FRAC_BITS;
+}
+
+// Q16 factor for a temperature in tenths of a degree (clamped to 0-50 C)
+int32_t tempFactorQ16(const Lut<TEMP_LUT_SIZE> &lut, int tempC10) {
+  if (tempC10 < 0)
+    tempC10 = 0;
+  if (tempC10 >= (TEMP_LUT_SIZE - 1) * 10)
+    return lut.v[TEMP_LUT_SIZE - 1];
+  int i = tempC10 / 10;
+  int32_t frac = tempC10 % 10;
+  return lut.v[i] + (lut.v[i + 1] - lut.v[i]) * frac / 10;
+}
+
+int32_t mulQ16(int32_t x, int32_t q16) {
+  return (int32_t)(((int64_t)x * q16 + (Q16_ONE / 2)) >> 16);
+}
+
+int32_t divQ16(int32_t x, int32_t q16) {
+  return (int32_t)(((int64_t)x * Q16_ONE + q16 / 2) / q16);
+}
+
+// Integer division rounded to nearest (d > 0)
+int64_t divRound(int64_t n, int64_t d) {
+  return n >= 0 ? (n + d / 2) / d : -((-n + d / 2) / d);
+}
+
+int32_t lerpPoints(const CalPoint &a, const CalPoint &b, int32_t mv16) {
+  if (b.mv == a.mv)
+    return a.value;
+  return a.value + (int32_t)divRound((int64_t)(mv16 - (a.mv << MV_FRAC_BITS)) *
+                                         (b.value - a.value),
+                                     (int64_t)(b.mv - a.mv) << MV_FRAC_BITS);
+}
+
+// Inverse of adcToMv16(): raw counts in 1/64ths, extrapolating past the
+// ends of the table
+int32_t mv16ToRawQ6(int32_t mv16) {
+  int lo = 0, hi = ADC_LUT_SIZE - 2; // Segment index
+  while (lo < hi) {
+    int mid = (lo + hi + 1) / 2;
+    if (adcMvLut.v[mid] <= mv16)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  int32_t a = adcMvLut.v[lo];
+  int32_t b = adcMvLut.v[lo + 1];
+  return (lo << (2 * ADC_LUT_SHIFT)) +
+         (int32_t)divRound((int64_t)(mv16 - a) << (2 * ADC_LUT_SHIFT), b - a);
+}
+
+// Default curve: full scale spread linearly over the raw ADC range
+int32_t calDefault(int32_t fullScale, int32_t mv16) {
+  return (int32_t)divRound((int64_t)mv16ToRawQ6(mv16) * fullScale,
+                           4095 << ADC_LUT_SHIFT);
+}
+
+int32_t calApply(const CalCurve &curve, int32_t fullScale,
+                 CalSinglePoint single, int32_t mv16) {
+  if (curve.count == 0)
+    return calDefault(fullScale, mv16);
+
+  if (curve.count == 1) {
+    // Single point: keep the default shape, shift the offset or scale it
+    // through the origin. The ratio is taken in raw counts, which is the
+    // default curve without its rounding.
+    const CalPoint &a = curve.pts[0];
+    if (single == CAL_SINGLE_OFFSET)
+      return a.value + calDefault(fullScale, mv16) -
+             calDefault(fullScale, a.mv << MV_FRAC_BITS);
+    int32_t at = mv16ToRawQ6(a.mv << MV_FRAC_BITS);
+    if (at <= 0)
+      return calDefault(fullScale, mv16); // No gain from a zero reading
+    return (int32_t)divRound((int64_t)mv16ToRawQ6(mv16) * a.value, at);
+  }
+
+  // Pick the segment, extrapolating with the end segments
+  int seg = 0;
+  while (seg < curve.count - 2 &&
+         mv16 > (curve.pts[seg + 1].mv << MV_FRAC_BITS))
+    seg++;
+  return lerpPoints(curve.pts[seg], curve.pts[seg + 1], mv16);
+}
+
+// For curves read back from flash: calApply() relies on both of these
+bool calCurveValid(const CalCurve &curve) {
+  if (curve.count > CAL_MAX_POINTS)
+    return false;
+  for (int i = 1; i < curve.count; i++) {
+    if (curve.pts[i].mv < curve.pts[i - 1].mv)
+      return false;
+  }
+  return true;
+}
+
+// Add or replace a calibration point, keeping the list sorted by mv
+void calCapture(CalCurve &curve, int32_t mv, int32_t value) {
+  int slot = -1;
+  for (int i = 0; i < curve.count; i++) {
+    int32_t d = curve.pts[i].mv - mv;
+    if (d < 0)
+      d = -d;
+    if (d <= CAL_SAME_POINT_MV || curve.pts[i].value == value) {
+      slot = i;
+      break;
+    }
+  }
+
+  if (slot == -1 && curve.count < CAL_MAX_POINTS) {
+    slot = curve.count++;
+  } else if (slot == -1) {
+    // Full: replace the point with the closest reference value
+    slot = 0;
+    for (int i = 1; i < curve.count; i++) {
+      int32_t di = curve.pts[i].value - value;
+      int32_t ds = curve.pts[slot].value - value;
+      if ((di < 0 ? -di : di) < (ds < 0 ? -ds : ds))
+        slot = i;
+    }
+  }
+  curve.pts[slot].mv = mv;
+  curve.pts[slot].value = value;
+
+  // Insertion sort, at most CAL_MAX_POINTS entries
+  for (int i = 1; i < curve.count; i++) {
+    CalPoint p = curve.pts[i];
+    int j = i - 1;
+    while (j >= 0 && curve.pts[j].mv > p.mv) {
+      curve.pts[j + 1] = curve.pts[j];
+      j--;
+    }
+    curve.pts[j + 1] = p;
+  }
+}
+
+// --- Conversions ---
+
+int32_t tdsCompensatedMv16(int raw, int tempC10) {
+  return mulQ16(adcToMv16(raw), tempFactorQ16(tdsTempLut, tempC10));
+}
+
+int32_t convertTdsPpm(int raw, const CalCurve &curve, int tempC10) {
+  int32_t ppm =
+      calApply(curve, TDS_FULL_SCALE_PPM, CAL_SINGLE_GAIN,
+               tdsCompensatedMv16(raw, tempC10));
+  return ppm < 0 ? 0 : ppm;
+}
+
+int32_t convertPhMilli(int raw, const CalCurve &curve, int tempC10) {
+  int32_t ph25 = calApply(curve, PH_FULL_SCALE_MILLI, CAL_SINGLE_OFFSET,
+                          adcToMv16(raw));
+  int32_t ph = PH_NEUTRAL_MILLI +
+               mulQ16(ph25 - PH_NEUTRAL_MILLI,
+                      tempFactorQ16(phTempLut, tempC10));
+  if (ph < 0)
+    return 0;
+  return ph > 14000 ? 14000 : ph;
+}
+
+// Capture helpers take the reference value of the standard solution
+void captureTdsPoint(CalCurve &curve, int raw, int tempC10, int32_t ppm) {
+  calCapture(curve, mv16ToMv(tdsCompensatedMv16(raw, tempC10)), ppm);
+}
+
+void capturePhPoint(CalCurve &curve, int raw, int tempC10,
+                    int32_t milliPh) {
+  // Store the 25 C equivalent so later temperatures scale correctly
+  int32_t ph25 = PH_NEUTRAL_MILLI +
+                 divQ16(milliPh - PH_NEUTRAL_MILLI,
+                        tempFactorQ16(phTempLut, tempC10));
+  calCapture(curve, mv16ToMv(adcToMv16(raw)), ph25);
+}
+
+#endif // CALIBRATION_H
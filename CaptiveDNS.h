@@ -0,0 +1,178 @@
+#ifndef CAPTIVE_DNS_H
+#define CAPTIVE_DNS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// ==========================================
+//        CAPTIVE PORTAL DNS RESPONDER
+// ==========================================
+// Every name resolves to the softAP IP. Replies are built straight from
+// the query plus a prebuilt answer record, inside the UDP receive
+// callback, so they never wait for loop() (or a blocking sensor read).
+// The packet code is plain C++ and can be benchmarked on a PC; only the
+// AsyncUDP glue at the bottom needs the ESP32 core.
+
+const uint16_t CAPTIVE_DNS_PORT = 53;
+const uint32_t CAPTIVE_DNS_TTL = 60;   // Seconds
+const size_t DNS_MAX_PACKET = 512;     // Classic UDP DNS limit
+
+// --- Rate Limiting (per client token bucket) ---
+const int DNS_MAX_CLIENTS = 8;         // softAP allows few stations
+const uint16_t DNS_BURST = 32;         // Queries allowed back to back
+const uint16_t DNS_REFILL_PER_SEC = 16;
+
+// DNS header flags
+const uint16_t DNS_FLAG_QR = 0x8000;   // Response
+const uint16_t DNS_FLAG_AA = 0x0400;   // Authoritative
+const uint16_t DNS_FLAG_RD = 0x0100;   // Recursion desired (echoed)
+const uint16_t DNS_OPCODE_MASK = 0x7800;
+const uint16_t DNS_TYPE_A = 1;
+const uint16_t DNS_TYPE_ANY = 255;
+
+struct DnsClientBucket {
+  uint32_t addr; // IPv4 in network order, 0 = free
+  uint16_t tokens;
+  unsigned long lastRefill;
+};
+
+struct CaptiveDnsState {
+  uint8_t answer[16]; // Prebuilt A record, name is a pointer to the question
+  DnsClientBucket clients[DNS_MAX_CLIENTS];
+  uint32_t answered;
+  uint32_t dropped; // Malformed or rate limited
+};
+
+CaptiveDnsState captiveDns;
+
+// --- Helper Functions ---
+
+void dnsBuildTemplate(CaptiveDnsState &st, const uint8_t ip[4]) {
+  const uint8_t rr[16] = {
+      0xC0, 0x0C,                              // Name: pointer to question
+      0x00, DNS_TYPE_A,                        // Type A
+      0x00, 0x01,                              // Class IN
+      (uint8_t)(CAPTIVE_DNS_TTL >> 24), (uint8_t)(CAPTIVE_DNS_TTL >> 16),
+      (uint8_t)(CAPTIVE_DNS_TTL >> 8),  (uint8_t)CAPTIVE_DNS_TTL,
+      0x00, 0x04,                              // RDLENGTH
+      ip[0], ip[1], ip[2], ip[3]};
+  memcpy(st.answer, rr, sizeof(rr));
+}
+
+// Token bucket per source address. Returns false if the client is over
+// its budget. Unknown clients take the least recently refilled slot.
+bool dnsAllowClient(CaptiveDnsState &st, uint32_t addr, unsigned long now) {
+  DnsClientBucket *slot = nullptr;
+  DnsClientBucket *oldest = &st.clients[0];
+  for (int i = 0; i < DNS_MAX_CLIENTS; i++) {
+    if (st.clients[i].addr == addr) {
+      slot = &st.clients[i];
+      break;
+    }
+    if (now - st.clients[i].lastRefill > now - oldest->lastRefill)
+      oldest = &st.clients[i];
+  }
+  if (!slot) {
+    slot = oldest;
+    slot->addr = addr;
+    slot->tokens = DNS_BURST;
+    slot->lastRefill = now;
+  }
+
+  unsigned long refill = (now - slot->lastRefill) * DNS_REFILL_PER_SEC / 1000;
+  if (refill > 0) {
+    unsigned long tokens = slot->tokens + refill;
+    if (tokens >= DNS_BURST) {
+      slot->tokens = DNS_BURST;
+      slot->lastRefill = now;
+    } else {
+      slot->tokens = tokens;
+      // Advance by whole tokens only, so the fraction carries over
+      slot->lastRefill += refill * 1000 / DNS_REFILL_PER_SEC;
+    }
+  }
+
+  if (slot->tokens == 0)
+    return false;
+  slot->tokens--;
+  return true;
+}
+
+// Build the reply for one query into out (at least DNS_MAX_PACKET bytes).
+// Returns the reply length, or 0 if the packet should be ignored.
+size_t dnsBuildReply(const CaptiveDnsState &st, const uint8_t *query,
+                     size_t len, uint8_t *out) {
+  if (len < 12 || len > DNS_MAX_PACKET - sizeof(st.answer))
+    return 0;
+
+  uint16_t flags = (query[2] << 8) | query[3];
+  uint16_t qdcount = (query[4] << 8) | query[5];
+  if ((flags & DNS_FLAG_QR) || (flags & DNS_OPCODE_MASK) || qdcount != 1)
+    return 0;
+
+  // Walk the single question name to find QTYPE
+  size_t pos = 12;
+  while (pos < len && query[pos] != 0) {
+    if (query[pos] & 0xC0) // No compression in a question we answer
+      return 0;
+    pos += query[pos] + 1;
+  }
+  if (pos + 5 > len)
+    return 0;
+  uint16_t qtype = (query[pos + 1] << 8) | query[pos + 2];
+  size_t questionEnd = pos + 5;
+
+  // Header + question copied as-is, then patched
+  memcpy(out, query, questionEnd);
+  uint16_t rflags = DNS_FLAG_QR | DNS_FLAG_AA | (flags & DNS_FLAG_RD);
+  out[2] = rflags >> 8;
+  out[3] = rflags & 0xFF;
+  out[8] = out[9] = 0;   // NSCOUNT
+  out[10] = out[11] = 0; // ARCOUNT (drops any EDNS OPT record)
+
+  // AAAA and friends get an empty NOERROR so clients fall back to A fast
+  if (qtype != DNS_TYPE_A && qtype != DNS_TYPE_ANY) {
+    out[6] = out[7] = 0;
+    return questionEnd;
+  }
+  out[6] = 0;
+  out[7] = 1; // ANCOUNT
+  memcpy(out + questionEnd, st.answer, sizeof(st.answer));
+  return questionEnd + sizeof(st.answer);
+}
+
+#ifdef ARDUINO
+#include <AsyncUDP.h>
+
+AsyncUDP dnsUdp;
+
+void startCaptiveDNS(IPAddress ip) {
+  uint8_t raw[4] = {ip[0], ip[1], ip[2], ip[3]};
+  dnsBuildTemplate(captiveDns, raw);
+
+  if (!dnsUdp.listen(CAPTIVE_DNS_PORT))
+    return;
+
+  // Runs in the network task, independent of loop()
+  dnsUdp.onPacket([](AsyncUDPPacket &packet) {
+    uint32_t addr = packet.remoteIP();
+    if (!dnsAllowClient(captiveDns, addr, millis())) {
+      captiveDns.dropped++;
+      return;
+    }
+
+    uint8_t reply[DNS_MAX_PACKET];
+    size_t n =
+        dnsBuildReply(captiveDns, packet.data(), packet.length(), reply);
+    if (n == 0) {
+      captiveDns.dropped++;
+      return;
+    }
+    packet.write(reply, n);
+    captiveDns.answered++;
+  });
+}
+#endif
+
+#endif // CAPTIVE_DNS_H
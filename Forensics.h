@@ -0,0 +1,165 @@
+#ifndef FORENSICS_H
+#define FORENSICS_H
+
+#include <Arduino.h>
+#include <esp_system.h>
+#include <esp_task_wdt.h>
+
+// ==========================================
+//        STALL & RESET FORENSICS
+// ==========================================
+// The loop marks which stage it is in, and relay switches are logged, in
+// a record that lives in RTC memory and survives watchdog, panic and
+// brownout resets. A task watchdog resets the board if loop() stalls.
+// After the reboot the previous record is kept for the web page/API.
+
+const uint32_t STALL_TIMEOUT_MS = 20000; // Task watchdog timeout
+const uint32_t FORENSICS_MAGIC = 0xF15CFA02; // Bump when the layout changes
+const int FORENSICS_RELAY_OPS = 16;
+
+enum LoopStage : uint8_t {
+  STAGE_BOOT,
+  STAGE_FEEDER,
+  STAGE_SENSORS,
+  STAGE_AUTOMATION,
+  STAGE_ACTUATION,
+  STAGE_BROADCAST,
+  STAGE_WS_CLEANUP,
+  STAGE_SCHEDULE,
+  STAGE_WIFI,
+  STAGE_DEFERRED,
+  STAGE_LOG,
+  STAGE_COUNT
+};
+
+const char *const stageNames[STAGE_COUNT] = {
+    "boot", "feeder",   "sensors", "automation", "actuation", "broadcast",
+    "ws",   "schedule", "wifi",    "deferred",   "log"};
+
+struct RelayOp {
+  uint32_t at; // millis()
+  uint8_t id;
+  uint8_t on;
+};
+
+struct ForensicsRecord {
+  uint32_t magic;
+  uint32_t bootCount;
+  uint8_t stage;                     // Stage loop() is in right now
+  uint32_t stageAt[STAGE_COUNT];     // millis() of last entry per stage
+  uint8_t slowestStage;              // Longest single stage so far
+  uint32_t slowestMs;
+  uint32_t loops;
+  RelayOp ops[FORENSICS_RELAY_OPS];  // Ring buffer of relay switches
+  uint8_t opHead;
+  uint8_t opCount;
+};
+
+RTC_NOINIT_ATTR ForensicsRecord rtcRecord; // Survives non power-on resets
+ForensicsRecord prevRecord;                // Copy from before this boot
+bool prevRecordValid = false;
+esp_reset_reason_t bootResetReason = ESP_RST_UNKNOWN;
+
+// --- Helper Functions ---
+
+const char *resetReasonName(esp_reset_reason_t r) {
+  switch (r) {
+  case ESP_RST_POWERON:
+    return "power_on";
+  case ESP_RST_EXT:
+    return "external";
+  case ESP_RST_SW:
+    return "software";
+  case ESP_RST_PANIC:
+    return "panic";
+  case ESP_RST_INT_WDT:
+    return "int_wdt";
+  case ESP_RST_TASK_WDT:
+    return "task_wdt";
+  case ESP_RST_WDT:
+    return "wdt";
+  case ESP_RST_DEEPSLEEP:
+    return "deep_sleep";
+  case ESP_RST_BROWNOUT:
+    return "brownout";
+  case ESP_RST_SDIO:
+    return "sdio";
+  default:
+    return "unknown";
+  }
+}
+
+// Hot path: a couple of stores per stage change. setup() (WiFi bring-up)
+// is left out of "slowest", timing starts at the first loop stage.
+inline void forensicsStage(LoopStage next) {
+  uint32_t now = millis();
+  uint32_t spent = now - rtcRecord.stageAt[rtcRecord.stage];
+  if (rtcRecord.stage != STAGE_BOOT && spent > rtcRecord.slowestMs) {
+    rtcRecord.slowestMs = spent;
+    rtcRecord.slowestStage = rtcRecord.stage;
+  }
+  rtcRecord.stage = next;
+  rtcRecord.stageAt[next] = now;
+}
+
+// Only called from loop() (relay changes from the web go through it)
+inline void forensicsRelayOp(int id, bool on) {
+  RelayOp &op = rtcRecord.ops[rtcRecord.opHead];
+  op.at = millis();
+  op.id = id;
+  op.on = on;
+  rtcRecord.opHead = (rtcRecord.opHead + 1) % FORENSICS_RELAY_OPS;
+  if (rtcRecord.opCount < FORENSICS_RELAY_OPS)
+    rtcRecord.opCount++;
+}
+
+// Call at the end of every loop(): feeds the watchdog
+inline void forensicsLoopDone() {
+  rtcRecord.loops++;
+  esp_task_wdt_reset();
+}
+
+// Call first thing in setup()
+void setupForensics() {
+  bootResetReason = esp_reset_reason();
+
+  // RTC memory is garbage after power-on, trust it only after a reset
+  prevRecordValid = bootResetReason != ESP_RST_POWERON &&
+                    rtcRecord.magic == FORENSICS_MAGIC &&
+                    rtcRecord.stage < STAGE_COUNT &&
+                    rtcRecord.slowestStage < STAGE_COUNT &&
+                    rtcRecord.opHead < FORENSICS_RELAY_OPS &&
+                    rtcRecord.opCount <= FORENSICS_RELAY_OPS;
+  uint32_t boots = 1;
+  if (prevRecordValid) {
+    prevRecord = rtcRecord;
+    boots = prevRecord.bootCount + 1;
+  }
+
+  memset(&rtcRecord, 0, sizeof(rtcRecord));
+  rtcRecord.magic = FORENSICS_MAGIC;
+  rtcRecord.bootCount = boots;
+  rtcRecord.stage = STAGE_BOOT;
+  rtcRecord.stageAt[STAGE_BOOT] = millis();
+
+  // Reset the board if loop() stops feeding the watchdog
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+  // Reconfigure replaces the whole config: keep the idle task monitoring
+  // the way the core set it up
+  uint32_t idleMask = 0;
+#if CONFIG_ESP_TASK_WDT_CHECK_IDLE_TASK_CPU0
+  idleMask |= 1 << 0;
+#endif
+#if CONFIG_ESP_TASK_WDT_CHECK_IDLE_TASK_CPU1
+  idleMask |= 1 << 1;
+#endif
+  esp_task_wdt_config_t cfg = {STALL_TIMEOUT_MS, idleMask, true};
+  if (esp_task_wdt_reconfigure(&cfg) != ESP_OK)
+    esp_task_wdt_init(&cfg);
+#else
+  esp_task_wdt_init(STALL_TIMEOUT_MS / 1000, true);
+#endif
+  esp_task_wdt_add(NULL);
+}
+
+#endif // FORENSICS_H
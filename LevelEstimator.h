@@ -0,0 +1,120 @@
+#ifndef LEVEL_ESTIMATOR_H
+#define LEVEL_ESTIMATOR_H
+
+// ==========================================
+//        WATER LEVEL ESTIMATOR (KALMAN)
+// ==========================================
+// One ultrasonic ping per tick, fused with a 2-state Kalman filter
+// (distance, drift rate). The known effect of the fill pump and drain
+// valve is fed in as a control input, so the estimate follows them
+// without lag, and surface ripple is averaged out instead of flapping the
+// fill relay. Pings far from the prediction are rejected as outliers.
+// A run of timeouts marks the sensor as faulted instead of extrapolating.
+// Pure logic (no Arduino calls); test/test_level.cpp replays a synthetic
+// trace against the old median-of-five.
+
+// --- Model (these need to be calibrated for the tank!) ---
+const float FILL_RATE_CM_S = -0.5;    // Distance change with fill pump on
+const float DRAIN_RATE_CM_S = 0.3;    // Distance change with drain valve open
+const float PING_NOISE_CM = 0.8;      // Std dev of one ping (ripple + sensor)
+const float RATE_NOISE_CM_S2 = 0.02;  // How fast the unmodelled rate drifts
+const float OUTLIER_GATE_SIGMA = 4.0; // Reject pings beyond this many sigma
+const int OUTLIER_RESET_COUNT = 5;    // This many rejects in a row = real jump
+const float PING_MAX_CM = 400.0;      // HC-SR04 range; timeouts read 999
+const float LEVEL_NO_READING = 999;   // Returned while there is no estimate
+const int LEVEL_FAULT_MISSES = 10;    // Timeouts in a row = sensor fault
+
+struct LevelEstimate {
+  bool ready;
+  float d;                // Estimated distance to surface (cm)
+  float v;                // Unmodelled rate (cm/s): leaks, evaporation
+  float p00, p01, p11;    // Covariance (symmetric)
+  unsigned long lastMs;
+  int rejects;            // Consecutive rejected pings
+  unsigned long outliers; // Total rejected pings
+  int misses;             // Consecutive timeouts
+  bool fault;             // No valid ping for LEVEL_FAULT_MISSES ticks
+};
+
+LevelEstimate levelEst = {false, 0, 0, 0, 0, 0, 0, 0, 0, 0, false};
+
+// --- Helper Functions ---
+
+void levelReset(LevelEstimate &e, float z, unsigned long nowMs) {
+  e.ready = true;
+  e.d = z;
+  e.v = 0;
+  e.p00 = PING_NOISE_CM * PING_NOISE_CM;
+  e.p01 = 0;
+  e.p11 = 0.25; // (0.5 cm/s)^2
+  e.lastMs = nowMs;
+  e.rejects = 0;
+  e.misses = 0;
+  e.fault = false;
+}
+
+// Feed one ping (cm, or <= 0 / >= PING_MAX_CM for a timeout) and the
+// pump states. Returns the filtered distance (never below 0), or
+// LEVEL_NO_READING before the first ping and while the sensor is faulted.
+float levelUpdate(LevelEstimate &e, float z, bool fillOn, bool drainOn,
+                  unsigned long nowMs) {
+  bool valid = z > 0 && z < PING_MAX_CM;
+  if (!e.ready) {
+    if (valid)
+      levelReset(e, z, nowMs);
+    return valid ? z : LEVEL_NO_READING;
+  }
+
+  // Predict
+  float dt = (nowMs - e.lastMs) / 1000.0;
+  e.lastMs = nowMs;
+  float u = (fillOn ? FILL_RATE_CM_S : 0) + (drainOn ? DRAIN_RATE_CM_S : 0);
+  e.d += (e.v + u) * dt;
+
+  float q = RATE_NOISE_CM_S2 * RATE_NOISE_CM_S2;
+  e.p00 += dt * (2 * e.p01 + dt * e.p11) + q * dt * dt * dt / 3;
+  e.p01 += dt * e.p11 + q * dt * dt / 2;
+  e.p11 += q * dt;
+
+  if (e.d < 0)
+    e.d = 0; // Surface can't be above the sensor
+
+  if (!valid) {
+    // Coast on the model for a few timeouts, then stop guessing. The
+    // next valid ping starts a fresh estimate.
+    if (++e.misses >= LEVEL_FAULT_MISSES) {
+      e.fault = true;
+      e.ready = false;
+      return LEVEL_NO_READING;
+    }
+    return e.d;
+  }
+  e.misses = 0;
+
+  // Gate on the innovation
+  float r = PING_NOISE_CM * PING_NOISE_CM;
+  float s = e.p00 + r;
+  float y = z - e.d;
+  if (y * y > OUTLIER_GATE_SIGMA * OUTLIER_GATE_SIGMA * s) {
+    e.outliers++;
+    if (++e.rejects >= OUTLIER_RESET_COUNT)
+      levelReset(e, z, nowMs); // Consistently elsewhere: trust the sensor
+    return e.d;
+  }
+  e.rejects = 0;
+
+  // Update
+  float k0 = e.p00 / s;
+  float k1 = e.p01 / s;
+  e.d += k0 * y;
+  e.v += k1 * y;
+  float p00 = e.p00, p01 = e.p01;
+  e.p00 -= k0 * p00;
+  e.p01 -= k0 * p01;
+  e.p11 -= k1 * p01;
+  if (e.d < 0)
+    e.d = 0;
+  return e.d;
+}
+
+#endif // LEVEL_ESTIMATOR_H
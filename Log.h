@@ -0,0 +1,331 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <string.h>
+#include <type_traits>
+
+// ==========================================
+//          DEFERRED LEVELED LOGGING
+// ==========================================
+// LOG_x() stores the format pointer and its arguments as raw 32-bit words
+// in a slot of a lock-free RAM ring and returns; no formatting and no UART
+// wait on the caller's side (a few hundred cycles). %s arguments are
+// copied, since they are often temporaries. logDrain(), called from the
+// end of loop(), formats the lines, writes them to Serial only as fast as
+// the TX FIFO has room, and hands each one to an optional sink (the WS
+// live log). Levels above LOG_LEVEL compile to nothing. Safe to call from
+// loop() and the web/network tasks at once.
+//
+// Formats must be string literals. Supported: %d %i %u %x %X %o %c %s %p
+// %f %e %g with flags, width, precision and the l/h/z modifiers. Integer
+// arguments are 32 bits and floating point ones are kept as float.
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+const int LOG_SLOTS = 32;      // Power of two
+const int LOG_LINE_MAX = 96;   // Longer messages are truncated
+const int LOG_DRAIN_LINES = 8; // Max lines handled per logDrain()
+const int LOG_MAX_ARGS = 6;
+const int LOG_STR_BYTES = 64;  // Room for copies of %s arguments
+
+// A formatted line, as written to Serial and handed to logSink
+struct LogRecord {
+  uint32_t ms;
+  uint8_t level;
+  char text[LOG_LINE_MAX];
+};
+
+// What the caller stores: formatted later by logPop()
+struct LogEntry {
+  uint32_t ms;
+  uint8_t level;
+  uint8_t argc;
+  const char *fmt;
+  uint32_t args[LOG_MAX_ARGS]; // Raw bits; %s args are offsets into strs
+  char strs[LOG_STR_BYTES];
+};
+
+// Bounded MPMC ring (Vyukov): a slot is free for position p when its
+// seq == p, and holds an entry for the consumer when seq == p + 1.
+struct LogSlot {
+  std::atomic<uint32_t> seq;
+  LogEntry entry;
+};
+
+LogSlot logRing[LOG_SLOTS];
+std::atomic<uint32_t> logHead(0);
+std::atomic<uint32_t> logDropped(0);
+uint32_t logTail = 0; // Only touched by logDrain()
+
+void (*logSink)(const LogRecord &) = nullptr;
+
+// --- Helper Functions ---
+
+const char logLevelChars[] = "-EWID";
+
+void logBegin(unsigned long baud) {
+  for (int i = 0; i < LOG_SLOTS; i++)
+    logRing[i].seq.store(i, std::memory_order_relaxed);
+  Serial.begin(baud);
+}
+
+// Claim the slot for the next position, or nullptr if the ring is full
+LogSlot *logClaim(uint32_t &pos) {
+  pos = logHead.load(std::memory_order_relaxed);
+  for (;;) {
+    LogSlot *slot = &logRing[pos % LOG_SLOTS];
+    uint32_t seq = slot->seq.load(std::memory_order_acquire);
+    int32_t diff = (int32_t)(seq - pos);
+    if (diff == 0) {
+      if (logHead.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed))
+        return slot;
+    } else if (diff < 0) {
+      logDropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    } else {
+      pos = logHead.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+// --- Argument packing (caller side) ---
+
+template <class T>
+typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value,
+                        uint32_t>::type
+logPack(LogEntry &, uint8_t &, T v) {
+  // long is 32 bits on the ESP32
+  static_assert(sizeof(T) <= 4 || sizeof(T) == sizeof(long),
+                "64-bit log arguments are not supported");
+  return (uint32_t)v;
+}
+
+inline uint32_t logPack(LogEntry &, uint8_t &, double v) {
+  float f = v;
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  return bits;
+}
+
+// Strings are copied: the caller's buffer may be gone by logDrain()
+inline uint32_t logPack(LogEntry &e, uint8_t &used, const char *s) {
+  uint32_t at = used;
+  if (!s)
+    s = "(null)";
+  while (*s && used < LOG_STR_BYTES - 1)
+    e.strs[used++] = *s++;
+  if (used < LOG_STR_BYTES - 1) {
+    e.strs[used++] = '\0';
+  } else {
+    at = at < LOG_STR_BYTES - 1 ? at : LOG_STR_BYTES - 1; // Truncated
+  }
+  return at;
+}
+
+inline uint32_t logPack(LogEntry &, uint8_t &, const void *p) {
+  return (uint32_t)(uintptr_t)p;
+}
+
+template <class... Args>
+void logWrite(uint8_t level, const char *fmt, Args... args) {
+  static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+  uint32_t pos;
+  LogSlot *slot = logClaim(pos);
+  if (!slot)
+    return;
+
+  LogEntry &e = slot->entry;
+  e.ms = millis();
+  e.level = level;
+  e.fmt = fmt;
+  e.argc = sizeof...(Args);
+  e.strs[LOG_STR_BYTES - 1] = '\0'; // Target for truncated strings
+  uint8_t used = 0;
+  uint32_t packed[] = {logPack(e, used, args)..., 0}; // Left to right
+  memcpy(e.args, packed, sizeof(uint32_t) * sizeof...(Args));
+  (void)used;
+  slot->seq.store(pos + 1, std::memory_order_release);
+}
+
+// Compile-time printf format check for the LOG_x() macros; never called
+inline void logCheckFormat(const char *, ...)
+    __attribute__((format(printf, 1, 2)));
+inline void logCheckFormat(const char *, ...) {}
+
+// --- Formatting (drain side) ---
+
+// printf for a stored entry: each conversion is handed to snprintf with
+// its argument cast back to the type the conversion expects
+void logFormat(const LogEntry &e, char *out, size_t cap) {
+  size_t n = 0;
+  int arg = 0;
+  const char *p = e.fmt;
+  while (*p && n + 1 < cap) {
+    if (*p != '%') {
+      out[n++] = *p++;
+      continue;
+    }
+    if (p[1] == '%') {
+      out[n++] = '%';
+      p += 2;
+      continue;
+    }
+
+    char spec[16];
+    size_t len = 0;
+    spec[len++] = *p++;
+    while (*p && strchr("-+ #0123456789.hlzjt", *p) && len < sizeof(spec) - 2)
+      spec[len++] = *p++;
+    char conv = *p;
+    if (!conv)
+      break;
+    p++;
+    spec[len++] = conv;
+    spec[len] = '\0';
+
+    uint32_t v = arg < e.argc ? e.args[arg++] : 0;
+    bool isLong = strchr(spec, 'l') != nullptr;
+    bool isSize = strchr(spec, 'z') != nullptr;
+    char *dst = out + n;
+    size_t room = cap - n;
+    int w = 0;
+    switch (conv) {
+    case 'd':
+    case 'i':
+      w = isLong   ? snprintf(dst, room, spec, (long)(int32_t)v)
+          : isSize ? snprintf(dst, room, spec, (size_t)v)
+                   : snprintf(dst, room, spec, (int)(int32_t)v);
+      break;
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+      w = isLong   ? snprintf(dst, room, spec, (unsigned long)v)
+          : isSize ? snprintf(dst, room, spec, (size_t)v)
+                   : snprintf(dst, room, spec, (unsigned)v);
+      break;
+    case 'c':
+      w = snprintf(dst, room, spec, (int)v);
+      break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G': {
+      float f;
+      memcpy(&f, &v, sizeof(f));
+      w = snprintf(dst, room, spec, (double)f);
+      break;
+    }
+    case 's':
+      w = snprintf(dst, room, spec,
+                   e.strs + (v < LOG_STR_BYTES ? v : LOG_STR_BYTES - 1));
+      break;
+    case 'p':
+      w = snprintf(dst, room, spec, (void *)(uintptr_t)v);
+      break;
+    }
+    if (w > 0)
+      n += (size_t)w < room ? (size_t)w : room - 1;
+  }
+  out[n] = '\0';
+}
+
+bool logPop(LogRecord &out) {
+  LogSlot &slot = logRing[logTail % LOG_SLOTS];
+  if (slot.seq.load(std::memory_order_acquire) != logTail + 1)
+    return false;
+  LogEntry e = slot.entry; // Free the slot before formatting
+  slot.seq.store(logTail + LOG_SLOTS, std::memory_order_release);
+  logTail++;
+
+  out.ms = e.ms;
+  out.level = e.level;
+  logFormat(e, out.text, LOG_LINE_MAX);
+  return true;
+}
+
+// Line currently being written to Serial (may take several calls)
+char logLine[LOG_LINE_MAX + 24];
+size_t logLineLen = 0;
+size_t logLineSent = 0;
+
+// Call from an idle point of loop(). Never blocks on the UART.
+void logDrain() {
+  for (int n = 0; n < LOG_DRAIN_LINES; n++) {
+    if (logLineSent == logLineLen) {
+      LogRecord r;
+      if (!logPop(r)) {
+        uint32_t dropped = logDropped.exchange(0);
+        if (dropped == 0)
+          return;
+        r.ms = millis();
+        r.level = LOG_LEVEL_WARN;
+        snprintf(r.text, LOG_LINE_MAX, "%lu log lines dropped",
+                 (unsigned long)dropped);
+      }
+      int len = snprintf(logLine, sizeof(logLine), "[%lu] %c %s\n",
+                         (unsigned long)r.ms, logLevelChars[r.level], r.text);
+      logLineLen = len < (int)sizeof(logLine) ? len : sizeof(logLine) - 1;
+      logLineSent = 0;
+      if (logSink)
+        logSink(r);
+    }
+
+    size_t room = Serial.availableForWrite();
+    if (room == 0)
+      return; // UART busy, try again next loop
+    size_t chunk = logLineLen - logLineSent;
+    if (chunk > room)
+      chunk = room;
+    Serial.write((const uint8_t *)logLine + logLineSent, chunk);
+    logLineSent += chunk;
+  }
+}
+
+// --- Macros (disabled levels compile to nothing) ---
+
+#define LOG_AT(level, ...)                                                     \
+  do {                                                                         \
+    if (false)                                                                 \
+      logCheckFormat(__VA_ARGS__);                                             \
+    logWrite(level, __VA_ARGS__);                                              \
+  } while (0)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+
+#endif // LOG_H
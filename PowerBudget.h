@@ -0,0 +1,176 @@
+#ifndef POWER_BUDGET_H
+#define POWER_BUDGET_H
+
+#include <stdint.h>
+
+// ==========================================
+//        RELAY ACTUATION POWER BUDGET
+// ==========================================
+// Motor loads draw a large inrush current for a short time after switching
+// on. Starting several of them in the same tick sags the supply and browns
+// out the ESP32, so turn-on requests are queued here and granted one at a
+// time, only while the estimated total current stays inside the budget.
+// Turn-offs are never delayed.
+
+// --- Load Ratings ---
+// These need to be calibrated against the actual pumps!
+struct LoadRating {
+  uint16_t inrushMa;  // Peak current right after switch-on
+  uint16_t steadyMa;  // Running current
+  uint16_t inrushMs;  // How long the inrush lasts
+  uint8_t priority;   // 0 = served first
+};
+
+// Index 0 unused, 1-6 match relays[] in Automation.h
+const LoadRating loadRatings[7] = {
+    {0, 0, 0, 0},
+    {2000, 600, 300, 0}, // 1: Fill pump
+    {1200, 400, 250, 1}, // 2: TDS drain/replace pump
+    {1200, 400, 250, 2}, // 3: TDS mineral pump
+    {600, 200, 150, 2},  // 4: pH up dosing pump
+    {600, 200, 150, 2},  // 5: pH down dosing pump
+    {500, 300, 50, 0},   // 6: Drain solenoid
+};
+
+const uint16_t POWER_BUDGET_MA = 2500;      // Total current for all relays
+const unsigned long TURN_ON_STAGGER_MS = 150; // Min gap between turn-ons
+// A waiting request gains one priority level per this much waiting time,
+// so low priority loads cannot be starved forever.
+const unsigned long POWER_AGING_MS = 5000;
+
+// --- Scheduler State ---
+struct ActuationSlot {
+  bool pending;              // Turn-on requested but not yet granted
+  bool on;                   // Mirrors the physical relay state
+  unsigned long requestedAt; // When the pending request was queued
+  unsigned long onSince;     // When the relay was last switched on
+  bool blocked;              // Last refused because of the budget
+  unsigned long blockedSince;
+  unsigned long waitMs;      // Total time refused for lack of budget
+};
+
+ActuationSlot powerSlots[7];
+unsigned long lastTurnOnMillis = 0;
+bool anyTurnOnYet = false;
+
+// --- Helper Functions ---
+
+uint16_t loadCurrentMa(int id, unsigned long now) {
+  if (!powerSlots[id].on)
+    return 0;
+  if (now - powerSlots[id].onSince < loadRatings[id].inrushMs)
+    return loadRatings[id].inrushMa;
+  return loadRatings[id].steadyMa;
+}
+
+uint16_t totalLoadCurrentMa(unsigned long now) {
+  uint16_t total = 0;
+  for (int i = 1; i <= 6; i++) {
+    total += loadCurrentMa(i, now);
+  }
+  return total;
+}
+
+// Queue a turn-on. Repeated requests keep their original queue position.
+void powerRequestOn(int id, unsigned long now) {
+  if (powerSlots[id].pending || powerSlots[id].on)
+    return;
+  powerSlots[id].pending = true;
+  powerSlots[id].requestedAt = now;
+}
+
+// Close an interval of being refused for budget
+void powerEndBlock(int id, unsigned long now) {
+  if (powerSlots[id].blocked) {
+    powerSlots[id].waitMs += now - powerSlots[id].blockedSince;
+    powerSlots[id].blocked = false;
+  }
+}
+
+void powerCancel(int id, unsigned long now) {
+  powerEndBlock(id, now);
+  powerSlots[id].pending = false;
+}
+
+// Drop every queued turn-on (e.g. automation handing over to the operator)
+void powerCancelAll(unsigned long now) {
+  for (int i = 1; i <= 6; i++) {
+    if (powerSlots[i].pending)
+      powerCancel(i, now);
+  }
+}
+
+// Called by the relay driver whenever the physical state changes.
+void powerNoteSwitched(int id, bool on, unsigned long now) {
+  powerSlots[id].on = on;
+  if (on) {
+    powerEndBlock(id, now);
+    powerSlots[id].pending = false;
+    powerSlots[id].onSince = now;
+    lastTurnOnMillis = now;
+    anyTurnOnYet = true;
+  }
+}
+
+// Returns the relay that may be switched on now, or 0 if none.
+// Highest (aged) priority wins; ties go to the oldest request.
+int powerPickNext(unsigned long now) {
+  if (anyTurnOnYet && now - lastTurnOnMillis < TURN_ON_STAGGER_MS)
+    return 0;
+
+  int best = 0;
+  long bestScore = 0;
+  for (int i = 1; i <= 6; i++) {
+    if (!powerSlots[i].pending)
+      continue;
+    long waited = now - powerSlots[i].requestedAt;
+    long score = (long)loadRatings[i].priority * POWER_AGING_MS - waited;
+    if (best == 0 || score < bestScore) {
+      best = i;
+      bestScore = score;
+    }
+  }
+  if (best == 0)
+    return 0;
+
+  // Loads waiting behind another one are not blocked by the budget
+  for (int i = 1; i <= 6; i++) {
+    if (i != best)
+      powerEndBlock(i, now);
+  }
+
+  // A single load larger than the budget may still start on its own
+  uint16_t total = totalLoadCurrentMa(now);
+  if (total > 0 && total + loadRatings[best].inrushMa > POWER_BUDGET_MA) {
+    if (!powerSlots[best].blocked) {
+      powerSlots[best].blocked = true;
+      powerSlots[best].blockedSince = now;
+    }
+    return 0;
+  }
+  powerEndBlock(best, now);
+  return best;
+}
+
+int powerPendingCount() {
+  int count = 0;
+  for (int i = 1; i <= 6; i++) {
+    if (powerSlots[i].pending)
+      count++;
+  }
+  return count;
+}
+
+// Total time loads were refused for budget, including the current
+// refusals. Never goes down.
+unsigned long powerTotalWaitMs(unsigned long now) {
+  unsigned long total = 0;
+  for (int i = 1; i <= 6; i++) {
+    total += powerSlots[i].waitMs;
+    if (powerSlots[i].blocked)
+      total += now - powerSlots[i].blockedSince;
+  }
+  return total;
+}
+
+#endif // POWER_BUDGET_H
@@ -0,0 +1,102 @@
+#ifndef STREAM_SEQ_H
+#define STREAM_SEQ_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <mutex>
+
+// ==========================================
+//      SEQUENCED BROADCASTS WITH REPLAY
+// ==========================================
+// Every broadcast gets a sequence number ("seq") and is kept in a small
+// replay ring. A reconnecting client sends {"cmd":"resume","ep":..,
+// "seq":..} and gets what it missed, or a fresh snapshot if it fell out
+// of the ring (or the device rebooted: new epoch "ep").
+//
+// Every broadcast type carries full state, so the replay is coalesced to
+// the newest missed message of each type: at most REPLAY_TYPES messages,
+// far below WS_MAX_QUEUED_MESSAGES even with the connect-time settings,
+// forensics, live broadcasts and log lines queued alongside.
+
+// ~12 s of sensors + states at full rate
+const int REPLAY_SIZE = 24;
+const int REPLAY_TYPES = 3; // sensors, states, settings
+
+struct StreamEntry {
+  uint32_t seq;
+  String type;
+  String msg;
+};
+
+StreamEntry replayRing[REPLAY_SIZE];
+uint32_t streamSeq = 0;   // Last sequence number handed out
+uint32_t streamEpoch = 0; // Random per boot
+std::mutex streamLock;    // Broadcasts come from loop() and the web task
+
+// --- Helper Functions ---
+
+void streamBegin() {
+  streamEpoch = esp_random();
+  if (streamEpoch == 0)
+    streamEpoch = 1; // 0 means "no epoch" from the client
+}
+
+// Stamp, remember and send to every client. Sending under the lock keeps
+// the wire order equal to the sequence order.
+void streamBroadcast(AsyncWebSocket &socket, JsonDocument &doc) {
+  std::lock_guard<std::mutex> guard(streamLock);
+  uint32_t seq = ++streamSeq;
+  doc["seq"] = seq;
+
+  StreamEntry &e = replayRing[seq % REPLAY_SIZE];
+  e.seq = seq;
+  e.type = doc["type"] | "";
+  e.msg = "";
+  serializeJson(doc, e.msg);
+  socket.textAll(e.msg);
+}
+
+// Send a per-client message that stands for the stream as of now
+void streamSnapshot(AsyncWebSocketClient *client, JsonDocument &doc) {
+  std::lock_guard<std::mutex> guard(streamLock);
+  doc["seq"] = streamSeq;
+  doc["ep"] = streamEpoch;
+  doc["snap"] = true;
+  String output;
+  serializeJson(doc, output);
+  client->text(output);
+}
+
+// Send the newest message of each type after lastSeq, in sequence order.
+// Returns false if that is no longer possible and the caller should send
+// a snapshot instead.
+bool streamReplay(AsyncWebSocketClient *client, uint32_t epoch,
+                  uint32_t lastSeq) {
+  std::lock_guard<std::mutex> guard(streamLock);
+  if (epoch != streamEpoch || lastSeq == 0 || lastSeq > streamSeq)
+    return false;
+  if (streamSeq - lastSeq > (uint32_t)REPLAY_SIZE)
+    return false; // Fell out of the ring
+
+  // Walk back from the newest, keeping the first hit of each type
+  uint32_t pick[REPLAY_TYPES];
+  int picked = 0;
+  for (uint32_t s = streamSeq; s > lastSeq && picked < REPLAY_TYPES; s--) {
+    const StreamEntry &e = replayRing[s % REPLAY_SIZE];
+    bool newer = false;
+    for (int i = 0; i < picked; i++) {
+      if (replayRing[pick[i] % REPLAY_SIZE].type == e.type)
+        newer = true;
+    }
+    if (!newer)
+      pick[picked++] = s;
+  }
+
+  for (int i = picked - 1; i >= 0; i--) {
+    client->text(replayRing[pick[i] % REPLAY_SIZE].msg);
+  }
+  return true;
+}
+
+#endif // STREAM_SEQ_H
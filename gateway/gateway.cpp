@@ -0,0 +1,634 @@
+// ==========================================
+//        SMART FISH FARM - LINUX GATEWAY
+// ==========================================
+// Keeps a WebSocket open to every tank controller, stores their
+// "sensors"/"states" broadcasts in a columnar memory-mapped store and fans
+// commands out to them. One epoll loop handles all node connections and
+// the local control socket.
+//
+// Build:  make -C gateway
+//         (or g++ -std=c++17 -O2 -o fishgw gateway/gateway.cpp)
+// Test:   make -C gateway check   (scripted run against the simulator)
+//
+// Usage:
+//   fishgw run   DIR host[:port] [host[:port] ...]   collect into DIR
+//   fishgw run   DIR --nodes FILE                    one node per line
+//   fishgw send  DIR <node|*> '<json>'               e.g. '{"cmd":"feed"}'
+//   fishgw status DIR                                connection overview
+//   fishgw settings DIR                              latest node settings
+//   fishgw query DIR [--node N] [--metric M] [--since SEC]
+//                    [--bucket SEC] [--agg avg|min|max|last|count]
+//
+// Try it without hardware against the simulator (gateway/node_sim.cpp):
+//   nodesim 9000 200 &  fishgw run /tmp/farm 127.0.0.1:9000+200
+
+#include "json_lite.h"
+#include "tsdb.h"
+#include "ws.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// --- Timing ---
+const int64_t RETRY_MIN_MS = 1000;
+const int64_t RETRY_MAX_MS = 30000;
+const int64_t SILENCE_TIMEOUT_MS = 30000; // Nodes broadcast every 1-10 s
+const int64_t CONNECT_TIMEOUT_MS = 5000;  // TCP connect + WS upgrade
+const int LOOP_TICK_MS = 250;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+int64_t clockMs(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Timers (retry, silence, connect): NTP steps must not stall them
+int64_t monoMs() { return clockMs(CLOCK_MONOTONIC); }
+
+// Row timestamps, ms since epoch (the store keeps them sorted)
+int64_t wallMs() { return clockMs(CLOCK_REALTIME); }
+
+// ==========================================
+//            NODE CONNECTIONS
+// ==========================================
+
+enum ConnState { DISCONNECTED, CONNECTING, HANDSHAKE, OPEN };
+const char *const stateNames[] = {"down", "connecting", "handshake", "up"};
+
+struct Node {
+  std::string name; // host:port as given
+  sockaddr_storage addr;
+  socklen_t addrLen = 0;
+  uint16_t index = 0; // Index in the store
+
+  int fd = -1;
+  ConnState state = DISCONNECTED;
+  std::string key; // Sec-WebSocket-Key of the current attempt
+  std::string in, out;
+  int64_t retryAt = 0;
+  int64_t backoff = RETRY_MIN_MS;
+  int64_t attemptAt = 0; // When the current connect started
+  uint64_t attempts = 0;
+  int64_t lastMsg = 0;
+
+  // The firmware sends "sensors" then "states" for each tick, so a
+  // sensors row waits here for the relay bits of the same tick
+  tsdb::Row pending = {};
+  bool hasPending = false;
+  uint8_t relays = 0; // Latest "states"
+  uint64_t samples = 0;
+  std::string settings; // Latest "settings" message, see "fishgw settings"
+};
+
+struct Control {
+  int fd;
+  std::string in;
+};
+
+class Gateway {
+public:
+  Gateway(tsdb::Store &store) : store_(store) {
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+  }
+
+  bool addNode(const std::string &spec) {
+    std::string host = spec, port = "80";
+    size_t colon = spec.rfind(':');
+    if (colon != std::string::npos) {
+      host = spec.substr(0, colon);
+      port = spec.substr(colon + 1);
+    }
+
+    addrinfo hints = {}, *res = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0 || !res) {
+      fprintf(stderr, "cannot resolve %s\n", spec.c_str());
+      return false;
+    }
+    std::unique_ptr<Node> n(new Node());
+    n->name = spec;
+    memcpy(&n->addr, res->ai_addr, res->ai_addrlen);
+    n->addrLen = res->ai_addrlen;
+    n->index = store_.nodeIndex(spec);
+    freeaddrinfo(res);
+    nodes_.push_back(std::move(n));
+    return true;
+  }
+
+  bool listenControl(const std::string &path) {
+    unlink(path.c_str());
+    ctlFd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    sockaddr_un sa = {};
+    sa.sun_family = AF_UNIX;
+    snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", path.c_str());
+    if (bind(ctlFd_, (sockaddr *)&sa, sizeof(sa)) != 0 ||
+        listen(ctlFd_, 16) != 0) {
+      perror("control socket");
+      return false;
+    }
+    watch(ctlFd_, EPOLLIN, &ctlFd_);
+    return true;
+  }
+
+  void run() {
+    std::vector<epoll_event> events(256);
+    while (!stopRequested) {
+      int64_t now = monoMs();
+      for (auto &n : nodes_) {
+        if (n->state == DISCONNECTED && now >= n->retryAt)
+          connectNode(*n);
+        else if (n->state == OPEN && now - n->lastMsg > SILENCE_TIMEOUT_MS)
+          dropNode(*n, "silent");
+        else if ((n->state == CONNECTING || n->state == HANDSHAKE) &&
+                 now - n->attemptAt > CONNECT_TIMEOUT_MS)
+          dropNode(*n, "connect timeout");
+      }
+
+      int count = epoll_wait(epfd_, events.data(), events.size(), LOOP_TICK_MS);
+      for (int i = 0; i < count; i++) {
+        void *tag = events[i].data.ptr;
+        uint32_t ev = events[i].events;
+        if (tag == &ctlFd_) {
+          acceptControl();
+        } else if (controls_.count((Control *)tag)) {
+          handleControl(*(Control *)tag);
+        } else {
+          handleNode(*(Node *)tag, ev);
+        }
+      }
+    }
+  }
+
+private:
+  void watch(int fd, uint32_t events, void *tag) {
+    epoll_event ev = {};
+    ev.events = events;
+    ev.data.ptr = tag;
+    if (epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &ev) != 0)
+      epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
+  }
+
+  // --- Node side ---
+
+  void connectNode(Node &n) {
+    n.fd = socket(n.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                  0);
+    int one = 1;
+    setsockopt(n.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(n.fd, (sockaddr *)&n.addr, n.addrLen) != 0 &&
+        errno != EINPROGRESS) {
+      dropNode(n, strerror(errno));
+      return;
+    }
+    n.state = CONNECTING;
+    n.attemptAt = monoMs();
+    n.attempts++;
+    n.in.clear();
+    n.out.clear();
+    watch(n.fd, EPOLLOUT, &n);
+  }
+
+  void dropNode(Node &n, const char *why) {
+    flushPending(n);
+    if (n.fd >= 0) {
+      epoll_ctl(epfd_, EPOLL_CTL_DEL, n.fd, nullptr);
+      close(n.fd);
+    }
+    if (n.state == OPEN)
+      fprintf(stderr, "%s: disconnected (%s)\n", n.name.c_str(), why);
+    n.fd = -1;
+    n.state = DISCONNECTED;
+    n.retryAt = monoMs() + n.backoff;
+    n.backoff = std::min(n.backoff * 2, RETRY_MAX_MS);
+  }
+
+  void queueSend(Node &n, const std::string &frame) {
+    n.out += frame;
+    flush(n);
+  }
+
+  void flush(Node &n) {
+    while (!n.out.empty()) {
+      ssize_t w = send(n.fd, n.out.data(), n.out.size(), MSG_NOSIGNAL);
+      if (w < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+          break;
+        dropNode(n, strerror(errno));
+        return;
+      }
+      n.out.erase(0, w);
+    }
+    watch(n.fd, n.out.empty() ? EPOLLIN : EPOLLIN | EPOLLOUT, &n);
+  }
+
+  void handleNode(Node &n, uint32_t ev) {
+    if (n.fd < 0)
+      return;
+    if (n.state == CONNECTING) {
+      int err = 0;
+      socklen_t len = sizeof(err);
+      getsockopt(n.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+      if (err != 0) {
+        dropNode(n, strerror(err));
+        return;
+      }
+      n.state = HANDSHAKE;
+      n.key = ws::randomKey();
+      queueSend(n, ws::clientHandshake(n.name, n.key));
+      return;
+    }
+
+    if (ev & EPOLLOUT) {
+      flush(n);
+      if (n.fd < 0)
+        return;
+    }
+    if (!(ev & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+      return;
+
+    char buf[16384];
+    for (;;) {
+      ssize_t r = recv(n.fd, buf, sizeof(buf), 0);
+      if (r > 0) {
+        n.in.append(buf, r);
+        continue;
+      }
+      if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        break;
+      dropNode(n, r == 0 ? "closed" : strerror(errno));
+      return;
+    }
+
+    if (n.state == HANDSHAKE) {
+      size_t end = n.in.find("\r\n\r\n");
+      if (end == std::string::npos)
+        return;
+      std::string head = n.in.substr(0, end + 2);
+      n.in.erase(0, end + 4);
+      if (head.compare(0, 12, "HTTP/1.1 101") != 0 ||
+          ws::headerValue(head, "Sec-WebSocket-Accept") !=
+              ws::acceptFor(n.key)) {
+        dropNode(n, "bad handshake");
+        return;
+      }
+      n.state = OPEN;
+      n.backoff = RETRY_MIN_MS;
+      n.lastMsg = monoMs();
+      fprintf(stderr, "%s: connected\n", n.name.c_str());
+    }
+
+    ws::Frame f;
+    bool bad = false;
+    while (n.fd >= 0 && ws::parseFrame(n.in, f, bad)) {
+      n.lastMsg = monoMs();
+      if (f.op == ws::OP_TEXT && f.fin) {
+        onMessage(n, f.payload);
+      } else if (f.op == ws::OP_PING) {
+        std::string pong;
+        ws::appendFrame(pong, ws::OP_PONG, f.payload, true);
+        queueSend(n, pong);
+      } else if (f.op == ws::OP_CLOSE) {
+        dropNode(n, "close frame");
+      }
+    }
+    if (bad)
+      dropNode(n, "bad frame");
+  }
+
+  // Store the waiting sensors row with the latest relay bits
+  void flushPending(Node &n) {
+    if (!n.hasPending)
+      return;
+    n.hasPending = false;
+    n.pending.relays = n.relays;
+    if (store_.append(n.pending))
+      n.samples++;
+  }
+
+  void onMessage(Node &n, const std::string &msg) {
+    std::string type = jsonl::string(msg, "type");
+    if (type == "sensors") {
+      flushPending(n); // Its "states" never came
+      tsdb::Row &row = n.pending;
+      double v = 0;
+      row.ts = wallMs();
+      row.node = n.index;
+      row.level = jsonl::number(msg, "level", v) ? v : NAN;
+      row.tds = jsonl::number(msg, "tds", v) ? v : NAN;
+      row.ph = jsonl::number(msg, "ph", v) ? v : NAN;
+      row.turb = jsonl::number(msg, "turb", v) ? v : NAN;
+      n.hasPending = true;
+    } else if (type == "states") {
+      uint8_t bits = 0;
+      bool on = false;
+      for (int i = 1; i <= 6; i++) {
+        std::string key = "p" + std::to_string(i);
+        if (jsonl::boolean(msg, key.c_str(), on) && on)
+          bits |= 1 << (i - 1);
+      }
+      if (jsonl::boolean(msg, "auto", on) && on)
+        bits |= 0x80;
+      n.relays = bits;
+      flushPending(n);
+    } else if (type == "settings") {
+      n.settings = msg;
+    }
+  }
+
+  // --- Control side ---
+
+  void acceptControl() {
+    int fd;
+    while ((fd = accept4(ctlFd_, nullptr, nullptr,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+      Control *c = new Control{fd, ""};
+      controls_[c] = std::unique_ptr<Control>(c);
+      watch(fd, EPOLLIN, c);
+    }
+  }
+
+  void closeControl(Control &c) {
+    epoll_ctl(epfd_, EPOLL_CTL_DEL, c.fd, nullptr);
+    close(c.fd);
+    controls_.erase(&c);
+  }
+
+  // One request line per connection, answered and closed
+  void handleControl(Control &c) {
+    char buf[4096];
+    ssize_t r;
+    while ((r = recv(c.fd, buf, sizeof(buf), 0)) > 0)
+      c.in.append(buf, r);
+    size_t nl = c.in.find('\n');
+    if (nl == std::string::npos) {
+      if (r == 0 || c.in.size() > 65536)
+        closeControl(c);
+      return;
+    }
+
+    std::string line = c.in.substr(0, nl), reply;
+    if (line.compare(0, 5, "send ") == 0) {
+      size_t sp = line.find(' ', 5);
+      std::string target = line.substr(5, sp - 5);
+      std::string json = sp == std::string::npos ? "" : line.substr(sp + 1);
+      std::string frame;
+      ws::appendFrame(frame, ws::OP_TEXT, json, true);
+      int sent = 0;
+      for (auto &n : nodes_) {
+        if (n->state == OPEN && (target == "*" || target == n->name)) {
+          queueSend(*n, frame);
+          sent++;
+        }
+      }
+      reply = "sent " + std::to_string(sent) + "\n";
+    } else if (line == "status") {
+      int64_t now = monoMs();
+      for (auto &n : nodes_) {
+        char row[256];
+        snprintf(row, sizeof(row),
+                 "%-24s %-10s samples=%llu last=%llds tries=%llu\n",
+                 n->name.c_str(), stateNames[n->state],
+                 (unsigned long long)n->samples,
+                 n->lastMsg ? (long long)(now - n->lastMsg) / 1000 : -1LL,
+                 (unsigned long long)n->attempts);
+        reply += row;
+      }
+    } else if (line == "settings") {
+      for (auto &n : nodes_) {
+        if (!n->settings.empty())
+          reply += n->name + " " + n->settings + "\n";
+      }
+    } else {
+      reply = "error unknown request\n";
+    }
+    send(c.fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+    closeControl(c);
+  }
+
+  tsdb::Store &store_;
+  int epfd_ = -1;
+  int ctlFd_ = -1;
+  std::vector<std::unique_ptr<Node>> nodes_;
+  std::map<Control *, std::unique_ptr<Control>> controls_;
+};
+
+// ==========================================
+//                 QUERY
+// ==========================================
+
+int runQuery(const std::string &dir, int argc, char **argv) {
+  tsdb::Store store;
+  if (!store.open(dir, false)) {
+    fprintf(stderr, "cannot open store %s\n", dir.c_str());
+    return 1;
+  }
+
+  std::string nodeName, agg = "avg";
+  int metric = -1;
+  int64_t since = 0, bucket = 0;
+  for (int i = 0; i + 1 < argc; i += 2) {
+    std::string opt = argv[i], val = argv[i + 1];
+    if (opt == "--node") {
+      nodeName = val;
+    } else if (opt == "--metric") {
+      for (int m = 0; m < tsdb::M_COUNT; m++)
+        if (val == tsdb::metricNames[m])
+          metric = m;
+    } else if (opt == "--since") {
+      since = atoll(val.c_str());
+    } else if (opt == "--bucket") {
+      bucket = atoll(val.c_str()) * 1000;
+    } else if (opt == "--agg") {
+      agg = val;
+    }
+  }
+
+  int nodeFilter = -1;
+  for (size_t i = 0; i < store.nodes().size(); i++)
+    if (store.nodes()[i] == nodeName)
+      nodeFilter = i;
+  if (!nodeName.empty() && nodeFilter < 0) {
+    fprintf(stderr, "unknown node %s\n", nodeName.c_str());
+    return 1;
+  }
+
+  uint64_t from = since > 0 ? store.lowerBound(wallMs() - since * 1000) : 0;
+  uint64_t to = store.rows();
+  const int64_t *ts = store.ts();
+  const uint16_t *node = store.node();
+
+  // Raw rows
+  if (bucket == 0 || metric < 0) {
+    printf("ts,node,level,tds,ph,turb,relays\n");
+    for (uint64_t r = from; r < to; r++) {
+      if (nodeFilter >= 0 && node[r] != nodeFilter)
+        continue;
+      printf("%lld,%s,%.2f,%.1f,%.2f,%.2f,0x%02x\n", (long long)ts[r],
+             store.nodes()[node[r]].c_str(), store.metric(tsdb::M_LEVEL)[r],
+             store.metric(tsdb::M_TDS)[r], store.metric(tsdb::M_PH)[r],
+             store.metric(tsdb::M_TURB)[r], store.relays()[r]);
+    }
+    return 0;
+  }
+
+  // Aggregate one column per time bucket (only that column is touched)
+  const float *col = store.metric((tsdb::Metric)metric);
+  printf("bucket_ts,%s_%s\n", tsdb::metricNames[metric], agg.c_str());
+  int64_t cur = -1;
+  double acc = 0;
+  uint64_t n = 0;
+  auto emit = [&]() {
+    if (n == 0)
+      return;
+    double v = agg == "avg" ? acc / n : agg == "count" ? n : acc;
+    printf("%lld,%.3f\n", (long long)cur, v);
+  };
+  for (uint64_t r = from; r < to; r++) {
+    if (nodeFilter >= 0 && node[r] != nodeFilter)
+      continue;
+    float v = col[r];
+    if (v != v) // NaN: field missing in that message
+      continue;
+    int64_t b = ts[r] - ts[r] % bucket;
+    if (b != cur) {
+      emit();
+      cur = b;
+      n = 0;
+      acc = agg == "min" ? 1e30 : agg == "max" ? -1e30 : 0;
+    }
+    if (agg == "min")
+      acc = std::min(acc, (double)v);
+    else if (agg == "max")
+      acc = std::max(acc, (double)v);
+    else if (agg == "last")
+      acc = v;
+    else
+      acc += v;
+    n++;
+  }
+  emit();
+  return 0;
+}
+
+// ==========================================
+//                  MAIN
+// ==========================================
+
+int controlRequest(const std::string &dir, const std::string &line) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un sa = {};
+  sa.sun_family = AF_UNIX;
+  snprintf(sa.sun_path, sizeof(sa.sun_path), "%s/ctl.sock", dir.c_str());
+  if (connect(fd, (sockaddr *)&sa, sizeof(sa)) != 0) {
+    fprintf(stderr, "gateway not running for %s\n", dir.c_str());
+    return 1;
+  }
+  std::string req = line + "\n";
+  send(fd, req.data(), req.size(), MSG_NOSIGNAL);
+  char buf[4096];
+  ssize_t r;
+  while ((r = recv(fd, buf, sizeof(buf), 0)) > 0)
+    fwrite(buf, 1, r, stdout);
+  close(fd);
+  return 0;
+}
+
+// "host:port+N" expands to N consecutive ports (handy with the simulator)
+void expandSpec(const std::string &spec, std::vector<std::string> &out) {
+  size_t plus = spec.rfind('+');
+  size_t colon = spec.rfind(':');
+  if (plus == std::string::npos || colon == std::string::npos ||
+      plus < colon) {
+    out.push_back(spec);
+    return;
+  }
+  int port = atoi(spec.substr(colon + 1, plus - colon - 1).c_str());
+  int count = atoi(spec.substr(plus + 1).c_str());
+  for (int i = 0; i < count; i++)
+    out.push_back(spec.substr(0, colon + 1) + std::to_string(port + i));
+}
+
+void onSignal(int) { stopRequested = 1; }
+
+int usage() {
+  fprintf(stderr, "usage: fishgw run|send|status|settings|query DIR ...\n");
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3)
+    return usage();
+  std::string cmd = argv[1], dir = argv[2];
+
+  if (cmd == "query")
+    return runQuery(dir, argc - 3, argv + 3);
+  if (cmd == "status" || cmd == "settings")
+    return controlRequest(dir, cmd);
+  if (cmd == "send") {
+    if (argc != 5)
+      return usage();
+    return controlRequest(dir, std::string("send ") + argv[3] + " " + argv[4]);
+  }
+  if (cmd != "run")
+    return usage();
+
+  std::vector<std::string> specs;
+  for (int i = 3; i < argc; i++) {
+    if (std::string(argv[i]) == "--nodes" && i + 1 < argc) {
+      std::ifstream in(argv[++i]);
+      std::string line;
+      while (std::getline(in, line))
+        if (!line.empty() && line[0] != '#')
+          expandSpec(line, specs);
+    } else {
+      expandSpec(argv[i], specs);
+    }
+  }
+  if (specs.empty())
+    return usage();
+
+  tsdb::Store store;
+  if (!store.open(dir, true)) {
+    fprintf(stderr, "cannot open store %s\n", dir.c_str());
+    return 1;
+  }
+
+  Gateway gw(store);
+  for (const std::string &s : specs)
+    gw.addNode(s);
+  if (!gw.listenControl(dir + "/ctl.sock"))
+    return 1;
+
+  struct sigaction sa = {};
+  sa.sa_handler = onSignal;
+  sigaction(SIGINT, &sa, nullptr);
+  sigaction(SIGTERM, &sa, nullptr);
+  signal(SIGPIPE, SIG_IGN);
+
+  fprintf(stderr, "fishgw: %zu nodes, store %s (%llu rows)\n", specs.size(),
+          dir.c_str(), (unsigned long long)store.rows());
+  gw.run();
+  return 0;
+}
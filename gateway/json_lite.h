@@ -0,0 +1,77 @@
+#ifndef GATEWAY_JSON_LITE_H
+#define GATEWAY_JSON_LITE_H
+
+// ==========================================
+//          FLAT JSON FIELD LOOKUP
+// ==========================================
+// The node messages are small flat objects ({"type":"sensors",
+// "level":12.3,...}), so the gateway pulls fields out by key instead of
+// building a DOM for every message.
+
+#include <stdlib.h>
+
+#include <string>
+
+namespace jsonl {
+
+// Position just after `"key":`, or npos
+inline size_t findValue(const std::string &msg, const char *key) {
+  std::string needle = std::string("\"") + key + "\"";
+  size_t pos = 0;
+  while ((pos = msg.find(needle, pos)) != std::string::npos) {
+    size_t p = pos + needle.size();
+    while (p < msg.size() && (msg[p] == ' ' || msg[p] == '\t'))
+      p++;
+    if (p < msg.size() && msg[p] == ':') {
+      p++;
+      while (p < msg.size() && (msg[p] == ' ' || msg[p] == '\t'))
+        p++;
+      return p;
+    }
+    pos = p;
+  }
+  return std::string::npos;
+}
+
+inline bool number(const std::string &msg, const char *key, double &out) {
+  size_t p = findValue(msg, key);
+  if (p == std::string::npos)
+    return false;
+  const char *start = msg.c_str() + p;
+  char *end = nullptr;
+  double v = strtod(start, &end);
+  if (end == start)
+    return false;
+  out = v;
+  return true;
+}
+
+inline bool boolean(const std::string &msg, const char *key, bool &out) {
+  size_t p = findValue(msg, key);
+  if (p == std::string::npos)
+    return false;
+  if (msg.compare(p, 4, "true") == 0) {
+    out = true;
+    return true;
+  }
+  if (msg.compare(p, 5, "false") == 0) {
+    out = false;
+    return true;
+  }
+  return false;
+}
+
+// String value without escape handling (node strings never need it)
+inline std::string string(const std::string &msg, const char *key) {
+  size_t p = findValue(msg, key);
+  if (p == std::string::npos || msg[p] != '"')
+    return "";
+  size_t end = msg.find('"', p + 1);
+  if (end == std::string::npos)
+    return "";
+  return msg.substr(p + 1, end - p - 1);
+}
+
+} // namespace jsonl
+
+#endif // GATEWAY_JSON_LITE_H
@@ -0,0 +1,220 @@
+// ==========================================
+//      FARM NODE SIMULATOR (for the gateway)
+// ==========================================
+// Pretends to be COUNT tank controllers on consecutive ports. Each one
+// speaks the same /ws protocol as the firmware: "settings" on connect,
+// "sensors" + "states" every second, and it obeys auto/toggle/feed.
+// The last MUTE nodes accept TCP but never answer the WebSocket upgrade.
+//
+// Build:  make -C gateway
+//         (or g++ -std=c++17 -O2 -o nodesim gateway/node_sim.cpp)
+// Usage:  nodesim BASE_PORT COUNT [INTERVAL_MS] [MUTE]
+
+#include "json_lite.h"
+#include "ws.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+struct SimNode {
+  int port;
+  int listenFd;
+  float level = 15, tds = 300, ph = 7.2f, turb = 3.0f;
+  bool autoMode = true;
+  bool relays[7] = {};
+  bool mute = false; // Never completes the handshake
+};
+
+struct SimClient {
+  int fd;
+  SimNode *node;
+  bool open = false;
+  std::string in;
+};
+
+static std::mt19937 rng(12345);
+
+float drift(float v, float step, float lo, float hi) {
+  std::uniform_real_distribution<float> d(-step, step);
+  v += d(rng);
+  return v < lo ? lo : v > hi ? hi : v;
+}
+
+std::string sensorsMsg(const SimNode &n) {
+  char buf[160];
+  snprintf(buf, sizeof(buf),
+           "{\"type\":\"sensors\",\"level\":%.2f,\"tds\":%.0f,\"ph\":%.2f,"
+           "\"turb\":%.2f}",
+           n.level, n.tds, n.ph, n.turb);
+  return buf;
+}
+
+std::string statesMsg(const SimNode &n) {
+  std::string s = "{\"type\":\"states\",\"auto\":";
+  s += n.autoMode ? "true" : "false";
+  for (int i = 1; i <= 6; i++)
+    s += ",\"p" + std::to_string(i) + "\":" + (n.relays[i] ? "true" : "false");
+  s += ",\"lf\":-1,\"nr\":-1,\"ct\":\"--:--\"}";
+  return s;
+}
+
+void sendText(SimClient &c, const std::string &msg) {
+  std::string frame;
+  ws::appendFrame(frame, ws::OP_TEXT, msg, false);
+  send(c.fd, frame.data(), frame.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+void handleCommand(SimNode &n, const std::string &msg) {
+  std::string cmd = jsonl::string(msg, "cmd");
+  double id = 0;
+  bool val = false;
+  if (cmd == "auto" && jsonl::boolean(msg, "val", val)) {
+    n.autoMode = val;
+  } else if (cmd == "toggle" && jsonl::number(msg, "id", id) && id >= 1 &&
+             id <= 6 && !n.autoMode) {
+    n.relays[(int)id] = !n.relays[(int)id];
+  }
+  fprintf(stderr, "port %d: %s\n", n.port, msg.c_str());
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: nodesim BASE_PORT COUNT [INTERVAL_MS] [MUTE]\n");
+    return 2;
+  }
+  int base = atoi(argv[1]), count = atoi(argv[2]);
+  int interval = argc > 3 ? atoi(argv[3]) : 1000;
+  int mute = argc > 4 ? atoi(argv[4]) : 0;
+  signal(SIGPIPE, SIG_IGN);
+
+  int ep = epoll_create1(0);
+  std::vector<std::unique_ptr<SimNode>> nodes;
+  std::map<int, SimNode *> listeners;
+  std::map<int, std::unique_ptr<SimClient>> clients;
+
+  for (int i = 0; i < count; i++) {
+    std::unique_ptr<SimNode> n(new SimNode());
+    n->port = base + i;
+    n->mute = i >= count - mute;
+    n->listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int one = 1;
+    setsockopt(n->listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in sa = {};
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sa.sin_port = htons(n->port);
+    if (bind(n->listenFd, (sockaddr *)&sa, sizeof(sa)) != 0 ||
+        listen(n->listenFd, 8) != 0) {
+      perror("listen");
+      return 1;
+    }
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = n->listenFd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, n->listenFd, &ev);
+    listeners[n->listenFd] = n.get();
+    nodes.push_back(std::move(n));
+  }
+  fprintf(stderr, "nodesim: %d nodes on ports %d-%d\n", count, base,
+          base + count - 1);
+
+  struct timespec last;
+  clock_gettime(CLOCK_MONOTONIC, &last);
+  epoll_event events[64];
+  for (;;) {
+    int nev = epoll_wait(ep, events, 64, 50);
+    for (int i = 0; i < nev; i++) {
+      int fd = events[i].data.fd;
+      auto l = listeners.find(fd);
+      if (l != listeners.end()) {
+        int cfd;
+        while ((cfd = accept4(fd, nullptr, nullptr, SOCK_NONBLOCK)) >= 0) {
+          std::unique_ptr<SimClient> c(
+              new SimClient{cfd, l->second, false, ""});
+          epoll_event ev = {};
+          ev.events = EPOLLIN;
+          ev.data.fd = cfd;
+          epoll_ctl(ep, EPOLL_CTL_ADD, cfd, &ev);
+          clients[cfd] = std::move(c);
+        }
+        continue;
+      }
+
+      SimClient &c = *clients[fd];
+      char buf[4096];
+      ssize_t r;
+      bool closed = false;
+      while ((r = recv(fd, buf, sizeof(buf), 0)) > 0)
+        c.in.append(buf, r);
+      if (r == 0 || (r < 0 && errno != EAGAIN))
+        closed = true;
+
+      if (!c.open && c.node->mute) {
+        c.in.clear();
+      } else if (!c.open) {
+        size_t end = c.in.find("\r\n\r\n");
+        if (end != std::string::npos) {
+          std::string key =
+              ws::headerValue(c.in.substr(0, end + 2), "Sec-WebSocket-Key");
+          c.in.erase(0, end + 4);
+          std::string resp = "HTTP/1.1 101 Switching Protocols\r\n"
+                             "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+                             "Sec-WebSocket-Accept: " +
+                             ws::acceptFor(key) + "\r\n\r\n";
+          send(fd, resp.data(), resp.size(), MSG_NOSIGNAL);
+          c.open = true;
+          sendText(c, "{\"type\":\"settings\",\"times\":[[7,0]],\"d\":1}");
+        }
+      }
+
+      ws::Frame f;
+      bool bad = false;
+      while (c.open && ws::parseFrame(c.in, f, bad)) {
+        if (f.op == ws::OP_TEXT)
+          handleCommand(*c.node, f.payload);
+        else if (f.op == ws::OP_CLOSE)
+          closed = true;
+      }
+      if (closed || bad) {
+        close(fd);
+        clients.erase(fd);
+      }
+    }
+
+    // Periodic broadcast, like notifyClients() on the device
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long elapsed = (now.tv_sec - last.tv_sec) * 1000 +
+                   (now.tv_nsec - last.tv_nsec) / 1000000;
+    if (elapsed < interval)
+      continue;
+    last = now;
+    for (auto &n : nodes) {
+      n->level = drift(n->level, 0.3f, 5, 30);
+      n->tds = drift(n->tds, 5, 50, 700);
+      n->ph = drift(n->ph, 0.05f, 5.5f, 9.0f);
+      n->turb = drift(n->turb, 0.05f, 1.5f, 3.3f);
+    }
+    for (auto &kv : clients) {
+      SimClient &c = *kv.second;
+      if (!c.open)
+        continue;
+      sendText(c, sensorsMsg(*c.node));
+      sendText(c, statesMsg(*c.node));
+    }
+  }
+}
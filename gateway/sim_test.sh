@@ -0,0 +1,80 @@
+#!/bin/sh
+# Scripted run of fishgw against nodesim (run via "make -C gateway check").
+# Checks that live nodes connect and are stored with the relay bits of
+# the same tick in timestamp order, that their settings are served, that
+# commands fan out, and that nodes which never answer the WebSocket
+# upgrade are timed out and retried.
+
+set -e
+cd "$(dirname "$0")"
+
+BASE=${BASE_PORT:-19300}
+LIVE=20
+MUTE=2
+DIR=$(mktemp -d)
+SIM_PID=
+GW_PID=
+
+cleanup() {
+  [ -n "$GW_PID" ] && kill "$GW_PID" 2>/dev/null || true
+  [ -n "$SIM_PID" ] && kill "$SIM_PID" 2>/dev/null || true
+  wait 2>/dev/null || true
+  rm -rf "$DIR"
+}
+trap cleanup EXIT
+
+fail() {
+  echo "sim_test: FAILED: $*"
+  cat "$DIR/status" 2>/dev/null || true
+  exit 1
+}
+
+./nodesim "$BASE" $((LIVE + MUTE)) 250 "$MUTE" 2>"$DIR/sim.log" &
+SIM_PID=$!
+sleep 0.5
+./fishgw run "$DIR" "127.0.0.1:$BASE+$((LIVE + MUTE))" 2>"$DIR/gw.log" &
+GW_PID=$!
+sleep 3
+
+# All live nodes up, mute ones stuck in the upgrade
+./fishgw status "$DIR" >"$DIR/status"
+UP=$(grep -c " up " "$DIR/status" || true)
+[ "$UP" -eq "$LIVE" ] || fail "$UP of $LIVE nodes up"
+
+# Latest settings message of every live node
+./fishgw settings "$DIR" >"$DIR/settings"
+SET=$(grep -c '"type":"settings"' "$DIR/settings" || true)
+[ "$SET" -eq "$LIVE" ] || fail "settings from $SET of $LIVE nodes"
+
+# Command fan-out
+SENT=$(./fishgw send "$DIR" '*' '{"cmd":"auto","val":false}')
+[ "$SENT" = "sent $LIVE" ] || fail "fan-out: $SENT"
+sleep 1
+grep -q '"cmd":"auto"' "$DIR/sim.log" || fail "command not received"
+
+# Every row before the command carries auto mode (bit 7), including the
+# first row of each node
+./fishgw query "$DIR" >"$DIR/rows"
+ROWS=$(($(wc -l <"$DIR/rows") - 1))
+[ "$ROWS" -ge $((LIVE * 4)) ] || fail "only $ROWS rows stored"
+# --since binary-searches ts, so it must stay sorted
+tail -n +2 "$DIR/rows" | cut -d, -f1 | sort -c -n 2>/dev/null ||
+  fail "timestamps out of order"
+for n in $(seq 0 $((LIVE - 1))); do
+  FIRST=$(grep ",127.0.0.1:$((BASE + n))," "$DIR/rows" | head -1)
+  case "$FIRST" in
+  *,0x80) ;;
+  *) fail "first row of node $n: $FIRST" ;;
+  esac
+done
+
+# Mute nodes time out (5 s) and are tried again after the backoff
+sleep 5
+./fishgw status "$DIR" >"$DIR/status"
+for n in $(seq $LIVE $((LIVE + MUTE - 1))); do
+  LINE=$(grep "^127.0.0.1:$((BASE + n)) " "$DIR/status")
+  TRIES=$(echo "$LINE" | sed 's/.*tries=//')
+  [ "$TRIES" -ge 2 ] || fail "mute node $n not retried: $LINE"
+done
+
+echo "sim_test: ok ($LIVE nodes, $ROWS rows, $MUTE mute nodes retried)"
@@ -0,0 +1,223 @@
+#ifndef GATEWAY_TSDB_H
+#define GATEWAY_TSDB_H
+
+// ==========================================
+//      COLUMNAR MEMORY-MAPPED SAMPLE STORE
+// ==========================================
+// One file per column, all memory-mapped and grown by doubling. Rows are
+// appended in arrival order and append() never lets a timestamp go
+// backwards, so the timestamp column is sorted and time ranges are found
+// by binary search. The row count lives in a small mapped header and is
+// bumped only after every column is written.
+//
+//   DIR/meta        header (magic, rows, capacity)
+//   DIR/ts.i64      gateway receive time, ms since epoch
+//   DIR/node.u16    index into DIR/nodes.txt
+//   DIR/level.f32, tds.f32, ph.f32, turb.f32
+//   DIR/relays.u8   bit 0-5 = p1..p6, bit 7 = auto mode, from the
+//                   "states" message of the same broadcast tick
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace tsdb {
+
+const uint32_t MAGIC = 0x46495348; // "FISH"
+const uint64_t INITIAL_ROWS = 4096;
+
+struct Row {
+  int64_t ts;
+  uint16_t node;
+  float level, tds, ph, turb;
+  uint8_t relays;
+};
+
+struct Meta {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t rows;
+  uint64_t capacity;
+};
+
+enum Metric { M_LEVEL, M_TDS, M_PH, M_TURB, M_COUNT };
+const char *const metricNames[M_COUNT] = {"level", "tds", "ph", "turb"};
+
+class Store {
+public:
+  ~Store() { close(); }
+
+  // Opens (and creates when writable) the store in dir
+  bool open(const std::string &dir, bool writable) {
+    dir_ = dir;
+    writable_ = writable;
+    if (writable)
+      mkdir(dir.c_str(), 0755);
+
+    meta_ = (Meta *)mapFile("meta", sizeof(Meta), metaFd_);
+    if (!meta_)
+      return false;
+    if (meta_->magic != MAGIC) {
+      if (!writable)
+        return false;
+      *meta_ = {MAGIC, 1, 0, 0};
+    }
+    if (!remapColumns(std::max<uint64_t>(meta_->capacity, INITIAL_ROWS)))
+      return false;
+    loadNodes();
+    return true;
+  }
+
+  void close() {
+    for (Column &c : cols_)
+      unmap(c.ptr, c.bytes, c.fd);
+    cols_.clear();
+    if (meta_) {
+      msync(meta_, sizeof(Meta), MS_SYNC);
+      void *p = meta_;
+      unmap(p, sizeof(Meta), metaFd_);
+      meta_ = nullptr;
+    }
+  }
+
+  // Rows visible through the current mapping (a reader sees the rows
+  // committed when it opened the store)
+  uint64_t rows() const {
+    return meta_ ? std::min<uint64_t>(meta_->rows, mapped_) : 0;
+  }
+
+  // ts is clamped to the last stored value, so a backward clock step
+  // cannot break the order lowerBound() relies on
+  bool append(const Row &r) {
+    uint64_t n = meta_->rows;
+    if (n >= meta_->capacity && !remapColumns(meta_->capacity * 2))
+      return false;
+    tsCol()[n] = n > 0 ? std::max(r.ts, tsCol()[n - 1]) : r.ts;
+    nodeCol()[n] = r.node;
+    metricCol(M_LEVEL)[n] = r.level;
+    metricCol(M_TDS)[n] = r.tds;
+    metricCol(M_PH)[n] = r.ph;
+    metricCol(M_TURB)[n] = r.turb;
+    relaysCol()[n] = r.relays;
+    __atomic_store_n(&meta_->rows, n + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  // Node names are append-only; index is stable for the life of the store
+  uint16_t nodeIndex(const std::string &name) {
+    for (size_t i = 0; i < nodes_.size(); i++)
+      if (nodes_[i] == name)
+        return i;
+    nodes_.push_back(name);
+    std::ofstream(dir_ + "/nodes.txt", std::ios::app) << name << "\n";
+    return nodes_.size() - 1;
+  }
+
+  const std::vector<std::string> &nodes() const { return nodes_; }
+
+  // First row with ts >= t
+  uint64_t lowerBound(int64_t t) const {
+    const int64_t *b = ts();
+    return std::lower_bound(b, b + rows(), t) - b;
+  }
+
+  const int64_t *ts() const { return (const int64_t *)cols_[0].ptr; }
+  const uint16_t *node() const { return (const uint16_t *)cols_[1].ptr; }
+  const float *metric(Metric m) const {
+    return (const float *)cols_[2 + m].ptr;
+  }
+  const uint8_t *relays() const { return (const uint8_t *)cols_[6].ptr; }
+
+private:
+  struct Column {
+    const char *file;
+    size_t width;
+    int fd;
+    void *ptr;
+    size_t bytes;
+  };
+
+  // Writable column views, used by append() only
+  int64_t *tsCol() { return (int64_t *)cols_[0].ptr; }
+  uint16_t *nodeCol() { return (uint16_t *)cols_[1].ptr; }
+  float *metricCol(Metric m) { return (float *)cols_[2 + m].ptr; }
+  uint8_t *relaysCol() { return (uint8_t *)cols_[6].ptr; }
+
+  void *mapFile(const char *name, size_t bytes, int &fd) {
+    std::string path = dir_ + "/" + name;
+    fd = ::open(path.c_str(), writable_ ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (fd < 0)
+      return nullptr;
+    struct stat st;
+    fstat(fd, &st);
+    if ((size_t)st.st_size < bytes) {
+      if (!writable_ || ftruncate(fd, bytes) != 0)
+        return nullptr;
+    }
+    int prot = writable_ ? PROT_READ | PROT_WRITE : PROT_READ;
+    void *p = mmap(nullptr, bytes, prot, MAP_SHARED, fd, 0);
+    return p == MAP_FAILED ? nullptr : p;
+  }
+
+  static void unmap(void *&ptr, size_t bytes, int &fd) {
+    if (ptr)
+      munmap(ptr, bytes);
+    if (fd >= 0)
+      ::close(fd);
+    ptr = nullptr;
+    fd = -1;
+  }
+
+  bool remapColumns(uint64_t capacity) {
+    static const Column layout[] = {
+        {"ts.i64", 8, -1, nullptr, 0},     {"node.u16", 2, -1, nullptr, 0},
+        {"level.f32", 4, -1, nullptr, 0},  {"tds.f32", 4, -1, nullptr, 0},
+        {"ph.f32", 4, -1, nullptr, 0},     {"turb.f32", 4, -1, nullptr, 0},
+        {"relays.u8", 1, -1, nullptr, 0}};
+    // Readers never grow: map exactly what the writer has committed
+    if (!writable_)
+      capacity = std::max<uint64_t>(meta_->rows, 1);
+
+    for (Column &c : cols_)
+      unmap(c.ptr, c.bytes, c.fd);
+    cols_.assign(layout, layout + 7);
+    for (Column &c : cols_) {
+      c.bytes = c.width * capacity;
+      c.ptr = mapFile(c.file, c.bytes, c.fd);
+      if (!c.ptr)
+        return false;
+    }
+    mapped_ = capacity;
+    if (writable_)
+      meta_->capacity = capacity;
+    return true;
+  }
+
+  void loadNodes() {
+    nodes_.clear();
+    std::ifstream in(dir_ + "/nodes.txt");
+    std::string line;
+    while (std::getline(in, line))
+      if (!line.empty())
+        nodes_.push_back(line);
+  }
+
+  std::string dir_;
+  bool writable_ = false;
+  Meta *meta_ = nullptr;
+  int metaFd_ = -1;
+  uint64_t mapped_ = 0;
+  std::vector<Column> cols_;
+  std::vector<std::string> nodes_;
+};
+
+} // namespace tsdb
+
+#endif // GATEWAY_TSDB_H
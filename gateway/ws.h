@@ -0,0 +1,235 @@
+#ifndef GATEWAY_WS_H
+#define GATEWAY_WS_H
+
+// ==========================================
+//        MINIMAL WEBSOCKET FRAMING
+// ==========================================
+// Just enough RFC 6455 for the farm nodes: HTTP upgrade handshake,
+// single-frame text messages, ping/pong and close. Shared by the gateway
+// (client side, masked frames) and the node simulator (server side).
+
+#include <stdint.h>
+#include <string.h>
+
+#include <random>
+#include <string>
+
+namespace ws {
+
+// --- SHA-1 / Base64 (handshake only) ---
+
+inline std::string sha1(const std::string &msg) {
+  uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476,
+                   0xC3D2E1F0};
+  std::string m = msg;
+  uint64_t bits = (uint64_t)msg.size() * 8;
+  m += (char)0x80;
+  while (m.size() % 64 != 56)
+    m += (char)0;
+  for (int i = 7; i >= 0; i--)
+    m += (char)(bits >> (i * 8));
+
+  auto rol = [](uint32_t x, int n) { return (x << n) | (x >> (32 - n)); };
+  for (size_t off = 0; off < m.size(); off += 64) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+      const uint8_t *p = (const uint8_t *)m.data() + off + i * 4;
+      w[i] = (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    }
+    for (int i = 16; i < 80; i++)
+      w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+      uint32_t f, k;
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      } else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+      uint32_t t = rol(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = rol(b, 30);
+      b = a;
+      a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+
+  std::string out;
+  for (int i = 0; i < 5; i++)
+    for (int j = 3; j >= 0; j--)
+      out += (char)(h[i] >> (j * 8));
+  return out;
+}
+
+inline std::string base64(const std::string &in) {
+  static const char *tbl =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string out;
+  size_t i = 0;
+  for (; i + 2 < in.size(); i += 3) {
+    uint32_t v = ((uint8_t)in[i] << 16) | ((uint8_t)in[i + 1] << 8) |
+                 (uint8_t)in[i + 2];
+    out += tbl[v >> 18];
+    out += tbl[(v >> 12) & 63];
+    out += tbl[(v >> 6) & 63];
+    out += tbl[v & 63];
+  }
+  if (i < in.size()) {
+    uint32_t v = (uint8_t)in[i] << 16;
+    if (i + 1 < in.size())
+      v |= (uint8_t)in[i + 1] << 8;
+    out += tbl[v >> 18];
+    out += tbl[(v >> 12) & 63];
+    out += i + 1 < in.size() ? tbl[(v >> 6) & 63] : '=';
+    out += '=';
+  }
+  return out;
+}
+
+inline std::string acceptFor(const std::string &key) {
+  return base64(sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC11B65"));
+}
+
+inline std::string randomKey() {
+  static std::mt19937 rng(std::random_device{}());
+  std::string raw;
+  for (int i = 0; i < 16; i++)
+    raw += (char)(rng() & 0xFF);
+  return base64(raw);
+}
+
+// --- Handshake ---
+
+inline std::string clientHandshake(const std::string &host,
+                                   const std::string &key) {
+  return "GET /ws HTTP/1.1\r\nHost: " + host +
+         "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+         "Sec-WebSocket-Key: " +
+         key + "\r\nSec-WebSocket-Version: 13\r\n\r\n";
+}
+
+// Value of an HTTP header (case-insensitive name), "" if missing
+inline std::string headerValue(const std::string &head,
+                               const std::string &name) {
+  std::string lower = head, want = name + ":";
+  for (auto &ch : lower)
+    ch = tolower(ch);
+  for (auto &ch : want)
+    ch = tolower(ch);
+  size_t pos = lower.find("\r\n" + want);
+  if (pos == std::string::npos)
+    return "";
+  pos += 2 + want.size();
+  size_t end = head.find("\r\n", pos);
+  std::string v = head.substr(pos, end - pos);
+  size_t b = v.find_first_not_of(" \t");
+  return b == std::string::npos ? "" : v.substr(b);
+}
+
+// --- Frames ---
+
+enum Opcode : uint8_t {
+  OP_TEXT = 0x1,
+  OP_CLOSE = 0x8,
+  OP_PING = 0x9,
+  OP_PONG = 0xA
+};
+
+// Clients must mask, servers must not
+inline void appendFrame(std::string &out, Opcode op, const std::string &data,
+                        bool mask) {
+  out += (char)(0x80 | op);
+  uint8_t m = mask ? 0x80 : 0;
+  if (data.size() < 126) {
+    out += (char)(m | data.size());
+  } else if (data.size() < 65536) {
+    out += (char)(m | 126);
+    out += (char)(data.size() >> 8);
+    out += (char)(data.size() & 0xFF);
+  } else {
+    out += (char)(m | 127);
+    for (int i = 7; i >= 0; i--)
+      out += (char)((uint64_t)data.size() >> (i * 8));
+  }
+  if (!mask) {
+    out += data;
+    return;
+  }
+  static std::mt19937 rng(std::random_device{}());
+  uint32_t key = rng();
+  char k[4] = {(char)(key >> 24), (char)(key >> 16), (char)(key >> 8),
+               (char)key};
+  out.append(k, 4);
+  size_t start = out.size();
+  out += data;
+  for (size_t i = 0; i < data.size(); i++)
+    out[start + i] ^= k[i & 3];
+}
+
+struct Frame {
+  Opcode op;
+  bool fin;
+  std::string payload;
+};
+
+// Pop one complete frame from the front of buf. Returns false if more
+// bytes are needed. Sets bad on a protocol error.
+inline bool parseFrame(std::string &buf, Frame &f, bool &bad) {
+  bad = false;
+  if (buf.size() < 2)
+    return false;
+  const uint8_t *p = (const uint8_t *)buf.data();
+  f.fin = p[0] & 0x80;
+  f.op = (Opcode)(p[0] & 0x0F);
+  bool masked = p[1] & 0x80;
+  uint64_t len = p[1] & 0x7F;
+  size_t pos = 2;
+  if (len == 126) {
+    if (buf.size() < 4)
+      return false;
+    len = (p[2] << 8) | p[3];
+    pos = 4;
+  } else if (len == 127) {
+    if (buf.size() < 10)
+      return false;
+    len = 0;
+    for (int i = 0; i < 8; i++)
+      len = (len << 8) | p[2 + i];
+    pos = 10;
+  }
+  if (len > (1u << 20)) { // Nodes never send anything close to this
+    bad = true;
+    return false;
+  }
+  size_t maskPos = pos;
+  if (masked)
+    pos += 4;
+  if (buf.size() < pos + len)
+    return false;
+
+  f.payload.assign(buf, pos, len);
+  if (masked)
+    for (size_t i = 0; i < len; i++)
+      f.payload[i] ^= buf[maskPos + (i & 3)];
+  buf.erase(0, pos + len);
+  return true;
+}
+
+} // namespace ws
+
+#endif // GATEWAY_WS_H
@@ -1,9 +1,13 @@
+#include "AdaptiveRate.h"
+#include "ApiSnapshot.h"
 #include "Automation.h"
+#include "CaptiveDNS.h"
+#include "Log.h"
 #include "Pins.h"
+#include "StreamSeq.h"
 #include "webpage.h"
 #include <ArduinoJson.h>
 #include <AsyncTCP.h>
-#include <DNSServer.h>
 #include <ESPAsyncWebServer.h>
 #include <ESPmDNS.h>
 #include <Preferences.h>
@@ -33,18 +37,16 @@ const int daylightOffset_sec = 0;
 // ==========================================
 AsyncWebServer server(80);
 AsyncWebSocket ws("/ws");
-DNSServer dnsServer;
-const byte DNS_PORT = 53;
 
 // ==========================================
 //            WEBSOCKET HANDLING
 // ==========================================
 
 volatile bool needsBroadcast = false;
+volatile bool needsWake = false; // Set from WS task, handled in loop()
 
-void notifySettings(AsyncWebSocketClient *client = nullptr) {
-  JsonDocument doc;
-  doc["type"] = "settings";
+// JSON builders shared by the WebSocket broadcasts and the REST snapshots
+void buildSettingsJson(JsonObject doc) {
   JsonArray times = doc["times"].to<JsonArray>();
   for (int i = 0; i < feedCount && i < MAX_FEED_TIMES; i++) {
     if (feedTimes[i][0] != -1) {
@@ -55,34 +57,24 @@ void notifySettings(AsyncWebSocketClient *client = nullptr) {
   }
   doc["d"] = servoDuration;
 
-  String output;
-  serializeJson(doc, output);
-
-  if (client) {
-    client->text(output);
-  } else {
-    ws.textAll(output);
-  }
+  // Calibration: water temperature and captured points per probe
+  doc["wt"] = waterTempC10 / 10.0;
+  doc["cph"] = phCurve.count;
+  doc["ctds"] = tdsCurve.count;
 }
 
-void notifyClients() {
-  // Defines a JSON buffer
-  JsonDocument doc;
-
-  // Sensor Data
-  doc["type"] = "sensors";
-  doc["level"] = currentDistance;
-  doc["tds"] = currentTDS;
-  doc["ph"] = currentPH;
-  doc["turb"] = currentTurbidity;
+// Rounded to what the probes resolve, so filter jitter alone does not
+// change the /api/state ETag
+float roundTo(float v, float step) { return roundf(v / step) * step; }
 
-  String output;
-  serializeJson(doc, output);
-  ws.textAll(output);
+void buildSensorsJson(JsonObject doc) {
+  doc["level"] = roundTo(currentDistance, 0.1);
+  doc["tds"] = roundTo(currentTDS, 1);
+  doc["ph"] = roundTo(currentPH, 0.01);
+  doc["turb"] = roundTo(currentTurbidity, 0.01);
+}
 
-  // Actuator States
-  doc.clear();
-  doc["type"] = "states";
+void buildStatesJson(JsonObject doc) {
   doc["auto"] = autoMode;
 
   // Use logical state from Automation.h for faster feedback
@@ -93,22 +85,172 @@ void notifyClients() {
   doc["p5"] = relays[5].active;
   doc["p6"] = relays[6].active;
 
+  doc["pq"] = powerPendingCount(); // Queued relay turn-ons
+  doc["idle"] = cadence.idle;       // Adaptive rate is in idle mode
+}
+
+// Counters and clocks that change every second. Kept apart from
+// buildStatesJson() so they don't churn the /api/state ETag.
+void buildTimersJson(JsonObject doc) {
+  // Power budget: total ms loads were refused for budget
+  doc["bw"] = powerTotalWaitMs(millis());
+
+  // Adaptive rate: % of uptime at full rate
+  doc["duty"] = cadenceDutyPercent(cadence);
+
   doc["lf"] = (lastFedMillis > 0) ? (millis() - lastFedMillis) / 1000 : -1;
   doc["nr"] = getSecondsToNextFeed();
 
   // Get current IST time
   struct tm timeinfo;
-  if (getLocalTime(&timeinfo)) {
+  if (getTimeNow(&timeinfo)) {
     char timeStr[10];
     strftime(timeStr, sizeof(timeStr), "%H:%M", &timeinfo);
     doc["ct"] = timeStr;
   } else {
     doc["ct"] = "--:--";
   }
+}
+
+void buildRelaysJson(JsonObject doc) {
+  doc["auto"] = autoMode;
+  JsonArray list = doc["relays"].to<JsonArray>();
+  for (int i = 1; i <= 6; i++) {
+    JsonObject r = list.add<JsonObject>();
+    r["id"] = i;
+    r["on"] = relays[i].active;
+    r["queued"] = powerSlots[i].pending;
+  }
+}
+
+void notifySettings(AsyncWebSocketClient *client = nullptr) {
+  JsonDocument doc;
+  doc["type"] = "settings";
+  buildSettingsJson(doc.as<JsonObject>());
+
+  if (client) {
+    doc["ep"] = streamEpoch; // Not sequenced: the client resumes after it
+    String output;
+    serializeJson(doc, output);
+    client->text(output);
+  } else {
+    streamBroadcast(ws, doc);
+  }
+}
+
+void notifyClients() {
+  // Defines a JSON buffer
+  JsonDocument doc;
+
+  // Sensor Data
+  doc["type"] = "sensors";
+  buildSensorsJson(doc.as<JsonObject>());
+
+  streamBroadcast(ws, doc);
+
+  // Actuator States
+  doc.clear();
+  doc["type"] = "states";
+  buildStatesJson(doc.as<JsonObject>());
+  buildTimersJson(doc.as<JsonObject>());
+  streamBroadcast(ws, doc);
+}
+
+// Reply to {"cmd":"resume"}: the missed broadcasts if they are still in
+// the replay ring, otherwise the current sensors and states.
+void resumeClient(AsyncWebSocketClient *client, uint32_t epoch,
+                  uint32_t lastSeq) {
+  if (streamReplay(client, epoch, lastSeq))
+    return;
+
+  JsonDocument doc;
+  doc["type"] = "sensors";
+  buildSensorsJson(doc.as<JsonObject>());
+  streamSnapshot(client, doc);
+
+  doc.clear();
+  doc["type"] = "states";
+  buildStatesJson(doc.as<JsonObject>());
+  buildTimersJson(doc.as<JsonObject>());
+  streamSnapshot(client, doc);
+}
+
+// ==========================================
+//               REST API
+// ==========================================
+
+// Rebuild the state and relay snapshots (once per control tick)
+void rebuildApiSnapshots() {
+  JsonDocument doc;
+  buildSensorsJson(doc["sensors"].to<JsonObject>());
+  buildStatesJson(doc["states"].to<JsonObject>());
+  String body;
+  serializeJson(doc, body);
+  apiPublish(apiState, body);
+
+  doc.clear();
+  buildRelaysJson(doc.to<JsonObject>());
+  String body2;
+  serializeJson(doc, body2);
+  apiPublish(apiRelays, body2);
+}
+
+// What the previous boot was doing when it reset; built once at boot
+void buildForensicsJson(JsonObject doc) {
+  doc["boot"] = rtcRecord.bootCount;
+  doc["reason"] = resetReasonName(bootResetReason);
+  doc["valid"] = prevRecordValid;
+  if (!prevRecordValid)
+    return;
+
+  const ForensicsRecord &r = prevRecord;
+  uint32_t last = r.stageAt[r.stage];
+  doc["stage"] = stageNames[r.stage];
+  doc["uptime"] = last; // ms, when the last stage was entered
+  doc["loops"] = r.loops;
+  doc["slowest"] = stageNames[r.slowestStage];
+  doc["slowestMs"] = r.slowestMs;
+
+  JsonObject stages = doc["stages"].to<JsonObject>();
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    stages[stageNames[i]] = r.stageAt[i];
+  }
+
+  // Oldest relay switch first
+  JsonArray ops = doc["ops"].to<JsonArray>();
+  int start =
+      (r.opHead - r.opCount + FORENSICS_RELAY_OPS) % FORENSICS_RELAY_OPS;
+  for (int i = 0; i < r.opCount; i++) {
+    const RelayOp &op = r.ops[(start + i) % FORENSICS_RELAY_OPS];
+    JsonArray o = ops.add<JsonArray>();
+    o.add(op.at);
+    o.add(op.id);
+    o.add(op.on);
+  }
+}
+
+String forensicsJson; // WS message, sent to every new client
+
+void publishForensics() {
+  JsonDocument doc;
+  buildForensicsJson(doc.to<JsonObject>());
+  String body;
+  serializeJson(doc, body);
+
+  doc["type"] = "forensics";
+  serializeJson(doc, forensicsJson);
+  apiPublish(apiForensics, body);
 
-  String output2;
-  serializeJson(doc, output2);
-  ws.textAll(output2);
+  LOG_INFO("Reset reason: %s", resetReasonName(bootResetReason));
+}
+
+// Settings only change on save, so this snapshot is rebuilt then
+void rebuildApiSettings() {
+  JsonDocument doc;
+  buildSettingsJson(doc.to<JsonObject>());
+  String body;
+  serializeJson(doc, body);
+  apiPublish(apiSettings, body);
 }
 
 void saveInternalSettings() {
@@ -126,7 +268,33 @@ void saveInternalSettings() {
     preferences.putInt(keyM, feedTimes[i][1]);
   }
   preferences.end();
-  Serial.println("Settings Saved to Flash");
+  LOG_INFO("Settings Saved to Flash");
+}
+
+void saveCalibration() {
+  preferences.begin("calib", false);
+  preferences.putBytes("ph", &phCurve, sizeof(phCurve));
+  preferences.putBytes("tds", &tdsCurve, sizeof(tdsCurve));
+  preferences.putShort("wt", waterTempC10);
+  preferences.end();
+  LOG_INFO("Calibration Saved to Flash");
+}
+
+void loadCalibration() {
+  preferences.begin("calib", true);
+  // A size mismatch or a broken curve means no (or stale) data: keep the
+  // default curves
+  CalCurve stored;
+  if (preferences.getBytesLength("ph") == sizeof(stored) &&
+      preferences.getBytes("ph", &stored, sizeof(stored)) == sizeof(stored) &&
+      calCurveValid(stored))
+    phCurve = stored;
+  if (preferences.getBytesLength("tds") == sizeof(stored) &&
+      preferences.getBytes("tds", &stored, sizeof(stored)) == sizeof(stored) &&
+      calCurveValid(stored))
+    tdsCurve = stored;
+  waterTempC10 = preferences.getShort("wt", WATER_TEMP_DEFAULT_C10);
+  preferences.end();
 }
 
 void loadInternalSettings() {
@@ -150,77 +318,189 @@ void loadInternalSettings() {
     feedTimes[i][1] = preferences.getInt(keyM, feedTimes[i][1]);
   }
   preferences.end();
-  Serial.println("Settings Loaded from Flash");
+  LOG_INFO("Settings Loaded from Flash");
+}
+
+// Shared command path for WebSocket messages and POST /api/command.
+// Returns false if the command is unknown or its arguments are invalid.
+bool handleCommand(JsonDocument &doc) {
+  String cmd = doc["cmd"];
+  if (cmd == "auto") {
+    if (!doc["val"].is<bool>())
+      return false;
+    autoModeWanted = doc["val"]; // Applied in loop()
+  } else if (cmd == "feed") {
+    runFeeder();
+  } else if (cmd == "toggle") {
+    int id = doc["id"] | 0;
+    if (id < 1 || id > 6)
+      return false;
+    toggleWanted[id] = true; // Applied (and broadcast) from loop()
+  } else if (cmd == "save_wifi") {
+    String new_ssid = doc["s"];
+    String new_pass = doc["p"];
+
+    if (new_ssid.length() == 0)
+      return false;
+
+    preferences.begin("wifi-config", false);
+    preferences.putString("ssid", new_ssid);
+    preferences.putString("password", new_pass);
+    preferences.end();
+
+    delay(1000);
+    ESP.restart();
+  } else if (cmd == "save_settings") {
+    // Receive array of feeding times
+    JsonArray times = doc["times"];
+    int d = doc["d"].as<int>(); // The page sends this as a string
+    if (times.isNull() || d < 0)
+      return false;
+    for (JsonArray slot : times) {
+      int h = slot[0] | -1;
+      int m = slot[1] | -1;
+      if (h < 0 || h > 23 || m < 0 || m > 59)
+        return false;
+    }
+
+    feedCount = 0;
+
+    // Clear all slots first
+    for (int i = 0; i < MAX_FEED_TIMES; i++) {
+      feedTimes[i][0] = -1;
+      feedTimes[i][1] = -1;
+    }
+
+    // Populate from received data
+    for (JsonArray slot : times) {
+      if (feedCount >= MAX_FEED_TIMES)
+        break;
+      feedTimes[feedCount][0] = slot[0];
+      feedTimes[feedCount][1] = slot[1];
+      feedCount++;
+    }
+
+    servoDuration = d;
+    saveInternalSettings();
+    LOG_INFO("Multiple Schedules Updated via Web");
+    rebuildApiSettings();
+    notifySettings(); // Broadcast updated schedules
+  } else if (cmd == "cal") {
+    // Capture the current probe reading as a point for reference value v
+    String sensor = doc["s"];
+    if (!doc["v"].is<float>())
+      return false;
+    float v = doc["v"];
+    if (sensor == "ph" && v >= 0 && v <= 14) {
+      capturePhPoint(phCurve, readRawAveraged(PIN_PH), waterTempC10,
+                     lroundf(v * 1000));
+    } else if (sensor == "tds" && v >= 0 && v <= 5000) {
+      captureTdsPoint(tdsCurve, readRawAveraged(PIN_TDS), waterTempC10,
+                      lroundf(v));
+    } else {
+      return false;
+    }
+    saveCalibration();
+    rebuildApiSettings();
+    notifySettings();
+  } else if (cmd == "cal_reset") {
+    String sensor = doc["s"];
+    if (sensor == "ph") {
+      phCurve.count = 0;
+    } else if (sensor == "tds") {
+      tdsCurve.count = 0;
+    } else {
+      return false;
+    }
+    saveCalibration();
+    rebuildApiSettings();
+    notifySettings();
+  } else if (cmd == "water_temp") {
+    float t = doc["val"] | -1.0f;
+    if (t < 0 || t > 50)
+      return false;
+    waterTempC10 = lroundf(t * 10);
+    saveCalibration();
+    rebuildApiSettings();
+    notifySettings();
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Live log: WS clients that sent {"cmd":"log","val":true}
+const int LOG_MAX_SUBSCRIBERS = 4;
+volatile uint32_t logSubscribers[LOG_MAX_SUBSCRIBERS]; // Client ids, 0 = free
+
+void setLogSubscription(uint32_t id, bool on) {
+  for (int i = 0; i < LOG_MAX_SUBSCRIBERS; i++) {
+    if (logSubscribers[i] == id)
+      logSubscribers[i] = 0;
+  }
+  if (!on)
+    return;
+  for (int i = 0; i < LOG_MAX_SUBSCRIBERS; i++) {
+    if (logSubscribers[i] == 0) {
+      logSubscribers[i] = id;
+      return;
+    }
+  }
+}
+
+// Log sink, runs from logDrain() in loop()
+void sendLogToClients(const LogRecord &r) {
+  String output;
+  for (int i = 0; i < LOG_MAX_SUBSCRIBERS; i++) {
+    uint32_t id = logSubscribers[i];
+    if (id == 0)
+      continue;
+    if (output.length() == 0) {
+      JsonDocument doc;
+      doc["type"] = "log";
+      doc["t"] = r.ms;
+      doc["lv"] = String(logLevelChars[r.level]);
+      doc["msg"] = r.text;
+      serializeJson(doc, output);
+    }
+    ws.text(id, output);
+  }
 }
 
-void handleWebSocketMessage(void *arg, uint8_t *data, size_t len) {
+void handleWebSocketMessage(AsyncWebSocketClient *client, void *arg,
+                            uint8_t *data, size_t len) {
   AwsFrameInfo *info = (AwsFrameInfo *)arg;
   if (info->final && info->index == 0 && info->len == len &&
       info->opcode == WS_TEXT) {
     JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, data);
+    DeserializationError error = deserializeJson(doc, data, len);
     if (error)
       return;
 
-    String cmd = doc["cmd"];
-    if (cmd == "auto") {
-      autoMode = doc["val"];
-    } else if (cmd == "feed") {
-      runFeeder();
-    } else if (cmd == "toggle") {
-      if (!autoMode) { // Only allow manual toggle if Auto Mode is OFF
-        toggleRelay(doc["id"]);
-      }
-      // Immediately notify clients of state change
-      notifyClients();
-    } else if (cmd == "save_wifi") {
-      String new_ssid = doc["s"];
-      String new_pass = doc["p"];
-
-      if (new_ssid.length() > 0) {
-        preferences.begin("wifi-config", false);
-        preferences.putString("ssid", new_ssid);
-        preferences.putString("password", new_pass);
-        preferences.end();
-
-        delay(1000);
-        ESP.restart();
-      }
-    } else if (cmd == "save_settings") {
-      // Receive array of feeding times
-      JsonArray times = doc["times"];
-      feedCount = 0;
-
-      // Clear all slots first
-      for (int i = 0; i < MAX_FEED_TIMES; i++) {
-        feedTimes[i][0] = -1;
-        feedTimes[i][1] = -1;
-      }
-
-      // Populate from received data
-      for (JsonArray slot : times) {
-        if (feedCount >= MAX_FEED_TIMES)
-          break;
-        feedTimes[feedCount][0] = slot[0];
-        feedTimes[feedCount][1] = slot[1];
-        feedCount++;
-      }
-
-      servoDuration = doc["d"];
-      saveInternalSettings();
-      Serial.println("Multiple Schedules Updated via Web");
-      notifySettings(); // Broadcast updated schedules
+    // Log subscription and resume are per connection, the rest is shared
+    if (doc["cmd"] == "log") {
+      setLogSubscription(client->id(), doc["val"] | false);
+      return;
+    }
+    if (doc["cmd"] == "resume") {
+      resumeClient(client, doc["ep"] | 0u, doc["seq"] | 0u);
+      return;
     }
+    handleCommand(doc);
   }
 }
 
 void onEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
              AwsEventType type, void *arg, uint8_t *data, size_t len) {
   if (type == WS_EVT_DATA) {
-    handleWebSocketMessage(arg, data, len);
+    handleWebSocketMessage(client, arg, data, len);
+  } else if (type == WS_EVT_DISCONNECT) {
+    setLogSubscription(client->id(), false);
   } else if (type == WS_EVT_CONNECT) {
-    Serial.println("WebSocket Connected");
+    LOG_INFO("WebSocket Connected");
+    needsWake = true;
     notifySettings(client); // Send settings ONLY on connect
+    client->text(forensicsJson);
   }
 }
 
@@ -231,13 +511,38 @@ void onEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
 unsigned long lastWifiCheck = 0;
 const unsigned long WIFI_CHECK_INTERVAL = 10000; // Check every 10 seconds
 
+// Feed the latest readings into the adaptive cadence. Only the sampling
+// and broadcast rates change; the radio stays on (see AdaptiveRate.h).
+void updateCadence() {
+  bool busy = isFeeding || powerPendingCount() > 0;
+  for (int i = 1; i <= 6; i++) {
+    busy = busy || relays[i].active;
+  }
+
+  CadenceInputs in;
+  in.level = currentDistance;
+  in.tds = currentTDS;
+  in.ph = currentPH;
+  in.turbidity = currentTurbidity;
+  in.relaysBusy = busy;
+  in.clients = ws.count() + (apiPolledRecently() ? 1 : 0);
+  in.secsToFeed = getSecondsToNextFeed();
+  if (cadenceUpdate(cadence, in, millis())) {
+    LOG_INFO("%s", cadence.idle ? "Idle: low rate" : "Active: full rate");
+  }
+}
+
 void setup() {
-  Serial.begin(115200);
+  setupForensics();
+  logBegin(115200);
+  logSink = sendLogToClients;
+  streamBegin();
 
   // Initialize Pins
   setupSensors();
   setupActuators();
   loadInternalSettings();
+  loadCalibration();
 
   // Connect to WiFi
   WiFi.mode(WIFI_AP_STA); // Dual Mode
@@ -249,8 +554,7 @@ void setup() {
 
   // 1. Setup Soft AP (Hotspot) Always - START IMMEDIATELY
   WiFi.softAP(ap_ssid, ap_password);
-  Serial.print("AP IP Address: ");
-  Serial.println(WiFi.softAPIP());
+  LOG_INFO("AP IP Address: %s", WiFi.softAPIP().toString().c_str());
 
   // 2. Load Credentials
   preferences.begin("wifi-config", true); // Read only
@@ -260,14 +564,13 @@ void setup() {
 
   if (ssid != "" && password != "") {
     // 3. Try Connect into Router (Non-Blocking)
-    Serial.print("Connecting to WiFi: ");
-    Serial.println(ssid);
+    LOG_INFO("Connecting to WiFi: %s", ssid.c_str());
     WiFi.begin(ssid.c_str(), password.c_str());
     WiFi.setSleep(false); // Improve responsiveness
     WiFi.setAutoReconnect(true);
     WiFi.persistent(true);
   } else {
-    Serial.println("No WiFi Credentials Saved.");
+    LOG_WARN("No WiFi Credentials Saved.");
   }
 
   // Setup Web Server
@@ -282,6 +585,57 @@ void setup() {
     request->send(response);
   });
 
+  // REST API for clients that can't keep a WebSocket open
+  server.on("/api/state", HTTP_GET, [](AsyncWebServerRequest *request) {
+    apiSend(request, apiState);
+  });
+  server.on("/api/settings", HTTP_GET, [](AsyncWebServerRequest *request) {
+    apiSend(request, apiSettings);
+  });
+  server.on("/api/relays", HTTP_GET, [](AsyncWebServerRequest *request) {
+    apiSend(request, apiRelays);
+  });
+  server.on("/api/forensics", HTTP_GET, [](AsyncWebServerRequest *request) {
+    apiSend(request, apiForensics);
+  });
+  // Changes every second, so built per request instead of cached
+  server.on("/api/timers", HTTP_GET, [](AsyncWebServerRequest *request) {
+    apiLastPoll = millis();
+    JsonDocument doc;
+    buildTimersJson(doc.to<JsonObject>());
+    String body;
+    serializeJson(doc, body);
+    AsyncWebServerResponse *response =
+        request->beginResponse(200, "application/json", body);
+    response->addHeader("Cache-Control", "no-store");
+    request->send(response);
+  });
+  server.on(
+      "/api/command", HTTP_POST,
+      [](AsyncWebServerRequest *request) {
+        // Runs after the body handler, which never sees an empty body
+        if (request->contentLength() == 0)
+          request->send(400, "application/json", "{\"ok\":false}");
+      },
+      nullptr,
+      [](AsyncWebServerRequest *request, uint8_t *data, size_t len,
+         size_t index, size_t total) {
+        // Same single-chunk rule as WebSocket frames
+        if (index != 0)
+          return;
+        if (len != total) {
+          request->send(413, "application/json", "{\"ok\":false}");
+          return;
+        }
+        JsonDocument doc;
+        if (deserializeJson(doc, data, len) || !handleCommand(doc)) {
+          request->send(400, "application/json", "{\"ok\":false}");
+          return;
+        }
+        needsBroadcast = true;
+        request->send(200, "application/json", "{\"ok\":true}");
+      });
+
   // Captive Portal Detection URLs (Apple, Android, Windows)
   server.on("/hotspot-detect.html", HTTP_GET,
             [](AsyncWebServerRequest *request) {
@@ -305,17 +659,20 @@ void setup() {
     request->send_P(200, "text/html", index_html);
   });
 
+  rebuildApiSettings();
+  rebuildApiSnapshots();
+  publishForensics();
   server.begin();
 
-  // 4. Start DNS Server for Captive Portal
-  dnsServer.start(DNS_PORT, "*", WiFi.softAPIP());
+  // 4. Start DNS Server for Captive Portal (answers from the UDP callback)
+  startCaptiveDNS(WiFi.softAPIP());
 
-  Serial.println("Web Server & DNS Started");
+  LOG_INFO("Web Server & DNS Started");
 
   // Setup mDNS
   if (MDNS.begin("fishfarm")) {
-    Serial.println("MDNS responder started");
-    Serial.println("Access via: http://fishfarm.local");
+    LOG_INFO("MDNS responder started");
+    LOG_INFO("Access via: http://fishfarm.local");
   }
 
   // Init and get the time
@@ -324,48 +681,80 @@ void setup() {
 
 void loop() {
   // 1. Handle Feeder Timing (Non-blocking)
+  forensicsStage(STAGE_FEEDER);
   updateFeeder();
+  if (applyRelayRequests()) // Mode changes and toggles from the web
+    needsBroadcast = true;
 
   // 2. Update Sensors & Automation periodically
+  //    Rate adapts: 200ms normally, slower when idle (see AdaptiveRate.h)
   static unsigned long lastSensorTime = 0;
-  if (millis() - lastSensorTime > 200) {
+  if (needsWake) {
+    needsWake = false;
+    if (cadence.idle) {
+      cadenceWake(cadence, millis());
+      lastSensorTime = 0; // Sample right away
+    }
+  }
+  if (millis() - lastSensorTime > cadenceSampleMs(cadence)) {
+    forensicsStage(STAGE_SENSORS);
     updateSensors();
+    forensicsStage(STAGE_AUTOMATION);
     runAutomation();
+    updateCadence();
+    if (apiPolledRecently()) {
+      rebuildApiSnapshots(); // Pollers get a fresh snapshot every tick
+    }
     lastSensorTime = millis();
   }
 
-  // 3. Limit WebSocket broadcasts to every 1000ms (Reduced form 500ms)
+  // 2b. Grant queued relay turn-ons within the power budget
+  forensicsStage(STAGE_ACTUATION);
+  updateActuation();
+
+  // 3. Limit WebSocket broadcasts to every 1000ms (10s when idle)
   static unsigned long lastTime = 0;
-  if (millis() - lastTime > 1000) {
+  if (millis() - lastTime > cadenceBroadcastMs(cadence)) {
+    forensicsStage(STAGE_BROADCAST);
     notifyClients();
+    if (!apiPolledRecently()) {
+      rebuildApiSnapshots(); // Keep it reasonably fresh for the next poll
+    }
     lastTime = millis();
     // Heartbeat
-    Serial.print("Alive: ");
-    Serial.println(millis());
+    LOG_DEBUG("Alive: %lu", millis());
   }
 
   // 4. Clean up WebSocket clients
+  forensicsStage(STAGE_WS_CLEANUP);
   ws.cleanupClients();
 
-  // 5. DNS Server for Captive Portal - Process EVERY LOOP for speed
-  dnsServer.processNextRequest();
-
-  // 6. Check Schedule
+  // 5. Check Schedule
+  forensicsStage(STAGE_SCHEDULE);
   checkSchedule();
 
-  // 7. Non-Blocking WiFi Reconnection Logic
+  // 6. Non-Blocking WiFi Reconnection Logic
   if (ssid != "" && millis() - lastWifiCheck > WIFI_CHECK_INTERVAL) {
+    forensicsStage(STAGE_WIFI);
     lastWifiCheck = millis();
     if (WiFi.status() != WL_CONNECTED) {
-      Serial.println("Reconnecting to WiFi...");
+      LOG_WARN("Reconnecting to WiFi...");
       WiFi.disconnect();
       WiFi.reconnect();
     }
   }
 
-  // 8. Handle Deferred Broadcasts (Immediate response to actions)
+  // 7. Handle Deferred Broadcasts (Immediate response to actions)
   if (needsBroadcast) {
+    forensicsStage(STAGE_DEFERRED);
     notifyClients();
     needsBroadcast = false;
   }
+
+  // 8. Drain the log ring to Serial / WS (never waits on the UART)
+  forensicsStage(STAGE_LOG);
+  logDrain();
+
+  // 9. Feed the stall watchdog
+  forensicsLoopDone();
 }
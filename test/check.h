@@ -0,0 +1,27 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+// ==========================================
+//        MINIMAL HOST TEST HELPERS
+// ==========================================
+// Each test is a plain program: CHECK() records failures, and main()
+// returns checkResult() so make stops on the first failing binary.
+
+int checkFailures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);          \
+      checkFailures++;                                                         \
+    }                                                                          \
+  } while (0)
+
+int checkResult(const char *name) {
+  printf("%s: %s\n", name, checkFailures ? "FAILED" : "ok");
+  return checkFailures ? 1 : 0;
+}
+
+#endif // CHECK_H
@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+"""Writes level_trace.csv, the synthetic tank trace used by test_level.cpp.
+
+One row per 200 ms control tick for 5 minutes: true distance to the
+surface, fill pump / drain valve state, and five HC-SR04 pings taken
+~40 ms apart in that tick (the Kalman filter uses the first, the old
+median-of-five uses all of them).
+
+The tank does not behave exactly like the filter's model (fill moves the
+surface at 0.35 cm/s, not 0.5; drain at 0.25, not 0.3), the surface has
+a 0.7 Hz ripple of 0.8 cm, pings have 0.5 cm noise, and 5% of them are
+outliers: a timeout (999) or an early echo.
+
+Usage: python3 gen_level_trace.py > level_trace.csv
+"""
+import math
+import random
+
+random.seed(20261019)
+
+TICK_S = 0.2
+TICKS = 1500
+FILL_CM_S = -0.35
+DRAIN_CM_S = 0.25
+EVAPORATION_CM_S = 0.01
+
+
+def ping(t, truth):
+    if random.random() < 0.05:
+        return 999.0 if random.random() < 0.5 else truth * random.random()
+    ripple = 0.8 * math.sin(2 * math.pi * 0.7 * t)
+    return truth + ripple + random.gauss(0, 0.5)
+
+
+truth = 20.0
+fill = False
+print("ms,truth,fill,drain,p0,p1,p2,p3,p4")
+for i in range(TICKS):
+    t = i * TICK_S
+    drain = 120 <= t < 150  # Water change: drain for 30 s
+    rate = EVAPORATION_CM_S
+    if fill:
+        rate += FILL_CM_S
+    if drain:
+        rate += DRAIN_CM_S
+    truth += rate * TICK_S
+    if truth > 25:
+        fill = True
+    if truth < 10:
+        fill = False
+    pings = [ping(t + j * 0.04, truth) for j in range(5)]
+    print("%d,%.3f,%d,%d,%s" % (i * 200, truth, fill, drain,
+                                ",".join("%.2f" % p for p in pings)))
@@ -0,0 +1,131 @@
+// Host test for AdaptiveRate.h: idle entry, wake triggers, duty cycle.
+
+#include "AdaptiveRate.h"
+#include "check.h"
+
+CadenceInputs quiet() {
+  CadenceInputs in;
+  in.level = 15.0;
+  in.tds = 300.0;
+  in.ph = 7.0;
+  in.turbidity = 3.0;
+  in.relaysBusy = false;
+  in.clients = 0;
+  in.secsToFeed = -1;
+  return in;
+}
+
+// Run quiet samples every 200 ms until idle; returns the time it went idle
+unsigned long settle(CadenceState &st, unsigned long t) {
+  for (int i = 0; i < 1000 && !st.idle; i++) {
+    cadenceUpdate(st, quiet(), t);
+    t += 200;
+  }
+  return t;
+}
+
+CadenceState fresh() {
+  CadenceState st = {false, false, 0, 0, 0, 0, 0, 0, 0, 0};
+  return st;
+}
+
+void testIdleEntry() {
+  CadenceState st = fresh();
+  unsigned long t = 1000;
+  CHECK(!cadenceUpdate(st, quiet(), t)); // First sample sets the reference
+  CHECK(!st.idle);
+
+  // Small noise below the thresholds still counts as stable
+  CadenceInputs in = quiet();
+  in.level += 0.5;
+  in.ph += 0.05;
+  CHECK(!cadenceUpdate(st, in, t + IDLE_ENTRY_MS - 1));
+  CHECK(!st.idle);
+  CHECK(cadenceUpdate(st, in, t + IDLE_ENTRY_MS)); // Mode change reported
+  CHECK(st.idle);
+  CHECK(!cadenceUpdate(st, in, t + IDLE_ENTRY_MS + 200)); // No repeat
+
+  CHECK(cadenceSampleMs(st) == SAMPLE_IDLE_MS);
+  CHECK(cadenceBroadcastMs(st) == BROADCAST_IDLE_MS);
+}
+
+void testWake(const char *what, CadenceInputs in) {
+  CadenceState st = fresh();
+  unsigned long t = settle(st, 1000);
+  CHECK(st.idle);
+  bool changed = cadenceUpdate(st, in, t);
+  if (!changed || st.idle)
+    printf("  wake trigger: %s\n", what);
+  CHECK(changed);
+  CHECK(!st.idle);
+  CHECK(cadenceSampleMs(st) == SAMPLE_FAST_MS);
+  CHECK(cadenceBroadcastMs(st) == BROADCAST_FAST_MS);
+}
+
+void testWakeTriggers() {
+  CadenceInputs in[7];
+  for (int i = 0; i < 7; i++)
+    in[i] = quiet();
+  in[0].level += 1.5;
+  in[1].tds -= 15;
+  in[2].ph += 0.2;
+  in[3].turbidity -= 0.2;
+  in[4].relaysBusy = true;
+  in[5].clients = 1;
+  in[6].secsToFeed = FEED_WAKE_SEC;
+  const char *names[7] = {"level",  "tds",    "ph",  "turbidity",
+                          "relays", "client", "feed"};
+  for (int i = 0; i < 7; i++)
+    testWake(names[i], in[i]);
+
+  // A feed further away does not wake it
+  CadenceState st = fresh();
+  unsigned long t = settle(st, 1000);
+  CadenceInputs far = quiet();
+  far.secsToFeed = FEED_WAKE_SEC + 1;
+  CHECK(!cadenceUpdate(st, far, t));
+  CHECK(st.idle);
+
+  // A moved reading becomes the new reference and can go idle again
+  cadenceUpdate(st, in[0], t + 200);
+  CHECK(!st.idle);
+  CHECK(!cadenceUpdate(st, in[0], t + 400));
+  CHECK(cadenceUpdate(st, in[0], t + 200 + IDLE_ENTRY_MS));
+  CHECK(st.idle);
+
+  // Explicit wake (WS connect)
+  cadenceWake(st, t + 500 + IDLE_ENTRY_MS);
+  CHECK(!st.idle);
+}
+
+void testDuty() {
+  CadenceState st = fresh();
+  CHECK(cadenceDutyPercent(st) == 100); // Nothing measured yet
+
+  // 30 s active, then 90 s idle
+  unsigned long t = 1000;
+  cadenceUpdate(st, quiet(), t);
+  t += IDLE_ENTRY_MS;
+  cadenceUpdate(st, quiet(), t);
+  CHECK(st.idle);
+  CHECK(st.activeMs == IDLE_ENTRY_MS);
+  t += 3 * IDLE_ENTRY_MS;
+  cadenceUpdate(st, quiet(), t);
+  CHECK(st.idleMs == 3 * IDLE_ENTRY_MS);
+  CHECK(cadenceDutyPercent(st) == 25);
+
+  // Waking charges the interval before it to idle
+  CadenceInputs in = quiet();
+  in.clients = 1;
+  t += 10000;
+  cadenceUpdate(st, in, t);
+  CHECK(st.idleMs == 3 * IDLE_ENTRY_MS + 10000);
+  CHECK(cadenceDutyPercent(st) == 23); // 30 / 130 s
+}
+
+int main() {
+  testIdleEntry();
+  testWakeTriggers();
+  testDuty();
+  return checkResult("test_cadence");
+}
@@ -0,0 +1,194 @@
+// Host test for Calibration.h: the integer pipeline against a double
+// reference over every raw count and 0-50 C, and the uncalibrated path
+// against the old map() demo mapping.
+
+#include "Calibration.h"
+#include "check.h"
+
+#include <math.h>
+
+// --- Double Reference ---
+
+double refMv(double raw) { return AdcMvGen::volts(raw) * 1000.0; }
+
+// Raw counts for a voltage: bisection inside the ADC range, end slopes
+// outside it
+double refRaw(double mv) {
+  const double top = 4095;
+  if (mv < refMv(0))
+    return (mv - refMv(0)) / (refMv(64) - refMv(0)) * 64;
+  if (mv > refMv(top))
+    return top + (mv - refMv(top)) / (refMv(4096) - refMv(4032)) * 64;
+  double lo = 0, hi = top;
+  for (int i = 0; i < 60; i++) {
+    double mid = (lo + hi) / 2;
+    if (refMv(mid) < mv)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+double refCurve(const CalCurve &c, double fullScale, CalSinglePoint single,
+                double mv) {
+  if (c.count == 0)
+    return fullScale * refRaw(mv) / 4095;
+  if (c.count == 1 && single == CAL_SINGLE_OFFSET)
+    return c.pts[0].value + fullScale * (refRaw(mv) - refRaw(c.pts[0].mv)) /
+                                4095;
+  if (c.count == 1)
+    return c.pts[0].value * refRaw(mv) / refRaw(c.pts[0].mv);
+  int s = 0;
+  while (s < c.count - 2 && mv > c.pts[s + 1].mv)
+    s++;
+  const CalPoint &a = c.pts[s], &b = c.pts[s + 1];
+  return a.value + (mv - a.mv) * (b.value - a.value) / (double)(b.mv - a.mv);
+}
+
+double refTdsPpm(int raw, const CalCurve &c, double tempC) {
+  double mv = refMv(raw) / (1.0 + 0.02 * (tempC - 25));
+  double ppm = refCurve(c, TDS_FULL_SCALE_PPM, CAL_SINGLE_GAIN, mv);
+  return ppm < 0 ? 0 : ppm;
+}
+
+double refPhMilli(int raw, const CalCurve &c, double tempC) {
+  double ph25 = refCurve(c, PH_FULL_SCALE_MILLI, CAL_SINGLE_OFFSET, refMv(raw));
+  double ph = PH_NEUTRAL_MILLI +
+              (ph25 - PH_NEUTRAL_MILLI) * 298.15 / (tempC + 273.15);
+  return ph < 0 ? 0 : ph > 14000 ? 14000 : ph;
+}
+
+// --- Tests ---
+
+// Cold water pushes the compensated TDS voltage far past the ADC range,
+// where both sides extrapolate, so TDS also gets a relative tolerance
+const double TDS_TOLERANCE_PPM = 3.0;
+const double TDS_TOLERANCE_REL = 0.002;
+const double PH_TOLERANCE_MILLI = 3.0; // 0.003 pH
+
+// A one-point TDS curve scales the default, and the ADC table's
+// interpolation error with it
+double tdsGain(const CalCurve &c) {
+  if (c.count != 1)
+    return 1;
+  double def = TDS_FULL_SCALE_PPM * refRaw(c.pts[0].mv) / 4095;
+  return fmax(1, c.pts[0].value / def);
+}
+
+double tdsTolerance(double ppm, double gain) {
+  return gain * fmax(TDS_TOLERANCE_PPM, TDS_TOLERANCE_REL * ppm);
+}
+
+void testLutMonotonic() {
+  for (int i = 1; i < ADC_LUT_SIZE; i++)
+    CHECK(adcMvLut.v[i] > adcMvLut.v[i - 1]);
+}
+
+// Uncalibrated boards must read like the old map() demo mapping
+void testDefaultMatchesMap() {
+  CalCurve none = {0, {}};
+  double worstTds = 0, worstPh = 0, exactTds = 0, exactPh = 0;
+  for (int raw = 0; raw < 4096; raw++) {
+    int32_t tds = convertTdsPpm(raw, none, 250);
+    int32_t ph = convertPhMilli(raw, none, 250);
+    long mapTds = (long)raw * 1000 / 4095; // map(raw, 0, 4095, 0, 1000)
+    long mapPh = (long)raw * 1400 / 4095;  // map(raw, 0, 4095, 0, 1400)
+    worstTds = fmax(worstTds, fabs(tds - (double)mapTds));
+    worstPh = fmax(worstPh, fabs(ph - mapPh * 10.0));
+    exactTds = fmax(exactTds, fabs(tds - raw * 1000.0 / 4095));
+    exactPh = fmax(exactPh, fabs(ph - raw * 14000.0 / 4095));
+  }
+  printf("  default vs map(): tds %.0f ppm, ph %.0f milli\n", worstTds,
+         worstPh);
+  printf("  default vs exact linear: tds %.2f ppm, ph %.2f milli\n", exactTds,
+         exactPh);
+  CHECK(worstTds <= 1);  // map() truncates to whole ppm
+  CHECK(worstPh <= 10);  // and to 0.01 pH
+  CHECK(exactTds <= 1);
+  CHECK(exactPh <= 2);
+
+  // Mid scale, where the old linear-in-mV default was off by 0.85 pH
+  CHECK(abs(convertPhMilli(2048, none, 250) - 7000) <= 10);
+  CHECK(abs(convertTdsPpm(2048, none, 250) - 500) <= 1);
+}
+
+void compareAll(const char *name, const CalCurve &tds, const CalCurve &ph) {
+  double worstTds = 0, worstPh = 0;
+  double gain = tdsGain(tds);
+  int tdsOut = 0, phOut = 0;
+  for (int raw = 0; raw < 4096; raw++) {
+    for (int t = 0; t <= 500; t += 5) { // Every half degree, 0-50 C
+      double refTds = refTdsPpm(raw, tds, t / 10.0);
+      double dTds = fabs(convertTdsPpm(raw, tds, t) - refTds);
+      double dPh = fabs(convertPhMilli(raw, ph, t) -
+                        refPhMilli(raw, ph, t / 10.0));
+      if (refTds <= TDS_FULL_SCALE_PPM)
+        worstTds = fmax(worstTds, dTds);
+      worstPh = fmax(worstPh, dPh);
+      tdsOut += dTds > tdsTolerance(refTds, gain);
+      phOut += dPh > PH_TOLERANCE_MILLI;
+    }
+  }
+  printf("  %-10s max error: tds %.2f ppm (in range), ph %.2f milli\n", name,
+         worstTds, worstPh);
+  CHECK(tdsOut == 0);
+  CHECK(phOut == 0);
+}
+
+void testAgainstReference() {
+  CalCurve none = {0, {}};
+  compareAll("default", none, none);
+
+  CalCurve tds1 = {0, {}}, ph1 = {0, {}};
+  captureTdsPoint(tds1, 1800, 220, 707);
+  capturePhPoint(ph1, 2000, 300, 7000);
+  CHECK(tds1.count == 1 && ph1.count == 1);
+  compareAll("one point", tds1, ph1);
+
+  // One TDS standard sets the gain: the point reads back and 0 ppm stays
+  // 0 ppm. One pH buffer shifts the offset: the slope is unchanged.
+  CHECK(abs(convertTdsPpm(1800, tds1, 220) - 707) <= 1);
+  CHECK(convertTdsPpm(0, tds1, 250) == 0);
+  CHECK(abs(convertPhMilli(2000, ph1, 300) - 7000) <= 2);
+  CHECK(abs(convertPhMilli(3000, ph1, 250) - convertPhMilli(2000, ph1, 250) -
+            (convertPhMilli(3000, none, 250) -
+             convertPhMilli(2000, none, 250))) <= 2);
+
+  CalCurve tds3 = {0, {}}, ph3 = {0, {}};
+  captureTdsPoint(tds3, 300, 220, 0);
+  captureTdsPoint(tds3, 1800, 220, 707);
+  captureTdsPoint(tds3, 3000, 220, 1413);
+  capturePhPoint(ph3, 1500, 300, 4000);
+  capturePhPoint(ph3, 2000, 300, 7000);
+  capturePhPoint(ph3, 2600, 300, 10000);
+  CHECK(tds3.count == 3 && ph3.count == 3);
+  compareAll("three pts", tds3, ph3);
+
+  // Captured points read back as their reference values
+  CHECK(abs(convertPhMilli(2000, ph3, 300) - 7000) <= 2);
+  CHECK(abs(convertPhMilli(1500, ph3, 300) - 4000) <= 2);
+  CHECK(abs(convertTdsPpm(1800, tds3, 220) - 707) <= 1);
+}
+
+void testCurveValid() {
+  CalCurve c = {0, {}};
+  CHECK(calCurveValid(c));
+  c.count = CAL_MAX_POINTS;
+  for (int i = 0; i < CAL_MAX_POINTS; i++)
+    c.pts[i].mv = 100 * i;
+  CHECK(calCurveValid(c));
+  c.count = CAL_MAX_POINTS + 1; // Would index past pts[]
+  CHECK(!calCurveValid(c));
+  c.count = 2;
+  c.pts[1].mv = -1; // Unsorted
+  CHECK(!calCurveValid(c));
+}
+
+int main() {
+  testLutMonotonic();
+  testDefaultMatchesMap();
+  testAgainstReference();
+  testCurveValid();
+  return checkResult("test_calibration");
+}
@@ -0,0 +1,151 @@
+// Host test for LevelEstimator.h: replays data/level_trace.csv (see
+// data/gen_level_trace.py) against the old median-of-five, and checks the
+// sensor fault and clamping behaviour.
+
+#include "LevelEstimator.h"
+#include "check.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+const float FILL_ON_CM = 25;  // Same hysteresis as the trace's own pump
+const float FILL_OFF_CM = 10;
+const int WARMUP_TICKS = 10;
+
+LevelEstimate freshEstimate() {
+  LevelEstimate e = {false, 0, 0, 0, 0, 0, 0, 0, 0, 0, false};
+  return e;
+}
+
+float median5(float p[5]) {
+  float s[5];
+  std::copy(p, p + 5, s);
+  std::sort(s, s + 5);
+  return s[2];
+}
+
+float percentile(std::vector<float> v, double p) {
+  std::sort(v.begin(), v.end());
+  return v[(size_t)(p * (v.size() - 1))];
+}
+
+struct Replay {
+  std::vector<float> err;
+  double sq = 0;
+  int switches = 0;
+  bool fill = false;
+
+  void add(float estimate, float truth) {
+    err.push_back(fabsf(estimate - truth));
+    sq += (estimate - truth) * (estimate - truth);
+    bool next = fill;
+    if (estimate > FILL_ON_CM)
+      next = true;
+    else if (estimate < FILL_OFF_CM)
+      next = false;
+    switches += next != fill;
+    fill = next;
+  }
+  float rmse() const { return sqrt(sq / err.size()); }
+};
+
+void testTrace(const char *path) {
+  FILE *f = fopen(path, "r");
+  CHECK(f != nullptr);
+  if (!f)
+    return;
+
+  LevelEstimate e = freshEstimate();
+  Replay kalman, median;
+  char line[256];
+  fgets(line, sizeof(line), f); // Header
+  int ticks = 0;
+  while (fgets(line, sizeof(line), f)) {
+    unsigned long ms;
+    float truth, p[5];
+    int fill, drain;
+    if (sscanf(line, "%lu,%f,%d,%d,%f,%f,%f,%f,%f", &ms, &truth, &fill,
+               &drain, &p[0], &p[1], &p[2], &p[3], &p[4]) != 9)
+      continue;
+    // One ping per tick for the filter, five for the old median
+    float k = levelUpdate(e, p[0], fill, drain, ms);
+    float m = median5(p);
+    if (++ticks > WARMUP_TICKS) {
+      kalman.add(k, truth);
+      median.add(m, truth);
+    }
+  }
+  fclose(f);
+  CHECK(ticks == 1500);
+
+  printf("  kalman (1 ping):   p50 %.2f  p95 %.2f  max %.2f  rmse %.2f cm, "
+         "%d fill switches, %lu outliers\n",
+         percentile(kalman.err, 0.5), percentile(kalman.err, 0.95),
+         percentile(kalman.err, 1.0), kalman.rmse(), kalman.switches,
+         e.outliers);
+  printf("  median (5 pings):  p50 %.2f  p95 %.2f  max %.2f  rmse %.2f cm, "
+         "%d fill switches\n",
+         percentile(median.err, 0.5), percentile(median.err, 0.95),
+         percentile(median.err, 1.0), median.rmse(), median.switches);
+
+  CHECK(percentile(kalman.err, 0.5) < 0.25);
+  CHECK(percentile(kalman.err, 0.5) < percentile(median.err, 0.5));
+  CHECK(percentile(kalman.err, 0.95) < percentile(median.err, 0.95));
+  CHECK(kalman.rmse() < median.rmse());
+  CHECK(kalman.switches <= median.switches);
+  CHECK(!e.fault);
+}
+
+// A dead sensor with the fill pump on must not drive the estimate
+// anywhere, and must be reported as "no reading"
+void testDeadSensor() {
+  LevelEstimate e = freshEstimate();
+  unsigned long t = 0;
+  for (int i = 0; i < 50; i++, t += 200)
+    levelUpdate(e, 20.0, false, false, t);
+
+  float out = 0;
+  int faultTick = -1;
+  for (int i = 0; i < 600; i++, t += 200) { // 120 s of timeouts
+    out = levelUpdate(e, 999, true, false, t);
+    if (faultTick < 0 && out == LEVEL_NO_READING)
+      faultTick = i;
+    CHECK(out >= 0);
+  }
+  CHECK(faultTick == LEVEL_FAULT_MISSES - 1);
+  CHECK(out == LEVEL_NO_READING);
+  CHECK(e.fault && !e.ready);
+
+  // The first good ping starts over from the measurement
+  out = levelUpdate(e, 18.0, true, false, t);
+  CHECK(out == 18.0f);
+  CHECK(!e.fault && e.ready);
+
+  // Occasional timeouts are bridged by the model
+  t += 200;
+  out = levelUpdate(e, 999, true, false, t);
+  CHECK(out < 18.0f && out > 17.0f);
+  CHECK(!e.fault);
+}
+
+// Surface at the sensor with the fill pump running: never negative
+void testClamp() {
+  LevelEstimate e = freshEstimate();
+  unsigned long t = 0;
+  for (int i = 0; i < 100; i++, t += 200) {
+    float out = levelUpdate(e, 0.3, true, false, t);
+    CHECK(out >= 0);
+  }
+  for (int i = 0; i < LEVEL_FAULT_MISSES - 1; i++, t += 200)
+    CHECK(levelUpdate(e, 999, true, false, t) >= 0);
+}
+
+int main(int argc, char **argv) {
+  testTrace(argc > 1 ? argv[1] : "data/level_trace.csv");
+  testDeadSensor();
+  testClamp();
+  return checkResult("test_level");
+}
@@ -0,0 +1,48 @@
+// Host test for PowerBudget.h: staggered grants and dropping the queue
+// when automation hands over to the operator.
+
+#include "PowerBudget.h"
+#include "check.h"
+
+#include <string.h>
+
+void reset() {
+  memset(powerSlots, 0, sizeof(powerSlots));
+  lastTurnOnMillis = 0;
+  anyTurnOnYet = false;
+}
+
+// Fill pump running in its inrush, TDS pump queued behind it
+void fillThenTds() {
+  reset();
+  powerRequestOn(1, 0);
+  CHECK(powerPickNext(0) == 1);
+  powerNoteSwitched(1, true, 0);
+  powerRequestOn(2, 10);
+  CHECK(powerPickNext(200) == 0); // 2000 + 1200 mA is over budget
+  CHECK(powerSlots[2].blocked);
+}
+
+void testGrantedAfterInrush() {
+  fillThenTds();
+  // Fill pump down to its steady current: 600 + 1200 mA fits
+  CHECK(powerPickNext(400) == 2);
+  CHECK(powerTotalWaitMs(400) == 200);
+}
+
+void testCancelAllDropsQueue() {
+  fillThenTds();
+  powerCancelAll(250); // Switched to manual
+  CHECK(powerPendingCount() == 0);
+  CHECK(!powerSlots[2].blocked);
+  CHECK(powerTotalWaitMs(250) == 50);
+  for (unsigned long t = 300; t < 600000; t += 100)
+    CHECK(powerPickNext(t) == 0);
+  CHECK(powerSlots[1].on); // Running loads are left alone
+}
+
+int main() {
+  testGrantedAfterInrush();
+  testCancelAllDropsQueue();
+  return checkResult("test_power");
+}
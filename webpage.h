@@ -333,6 +333,13 @@ const char index_html[] PROGMEM = R"rawliteral(
             <input id="ssid" placeholder="WiFi SSID">
             <input id="pass" type="password" placeholder="Password">
             <button class="btn" onclick="saveWifi()">Save & Reboot</button>
+            <p id="last-reset" style="opacity:0.6; margin-top:10px"></p>
+        </div>
+
+        <div class="card" style="margin-top:15px">
+            <div class="card-title">LIVE LOG</div>
+            <button id="log-btn" class="btn" onclick="togLog()">Start</button>
+            <pre id="log" style="max-height:200px; overflow:auto; font-size:0.7rem; opacity:0.8; white-space:pre-wrap"></pre>
         </div>
 
         <div class="card" style="margin-top:15px">
@@ -345,6 +352,22 @@ const char index_html[] PROGMEM = R"rawliteral(
             
             <button class="btn success" style="background:var(--success)" onclick="saveSet()">Save Settings</button>
         </div>
+
+        <div class="card" style="margin-top:15px">
+            <div class="card-title">PROBE CALIBRATION</div>
+            <p style="opacity:0.6; margin-bottom:10px">Dip the probe in a standard solution, enter its value and capture. <span id="cal-pts"></span></p>
+            <select id="cal-s">
+                <option value="ph">pH</option>
+                <option value="tds">TDS (ppm)</option>
+            </select>
+            <input id="cal-v" type="number" step="0.01" placeholder="Reference value (e.g. 7.00)">
+            <button class="btn" onclick="calCap()">Capture Point</button>
+            <button class="btn danger" style="margin-bottom:10px" onclick="calReset()">Reset Probe</button>
+
+            <div class="card-title" style="margin-top:15px">WATER TEMPERATURE (&deg;C)</div>
+            <input id="wt" type="number" value="25" min="0" max="50" step="0.1">
+            <button class="btn" onclick="saveTemp()">Set Temperature</button>
+        </div>
     </div>
 
     <!-- NAVIGATION DOCK -->
@@ -365,12 +388,15 @@ const char index_html[] PROGMEM = R"rawliteral(
 
     <script>
         var ws, t, scheds = [];
+        var lastSeq = 0, lastEp = 0; // Stream position, for resume
         const $ = (id) => document.getElementById(id);
 
         function con() {
             // Reconnect logic
             ws = new WebSocket('ws://' + location.hostname + '/ws');
             ws.onopen = () => { 
+                ws.send(JSON.stringify({cmd:'resume', ep:lastEp, seq:lastSeq}));
+                if(logOn) ws.send(JSON.stringify({cmd:'log', val:true}));
                 $('conn-dot').className = 'status-dot';
                 $('conn-txt').innerText = 'LIVE';
             };
@@ -381,9 +407,18 @@ const char index_html[] PROGMEM = R"rawliteral(
             };
             ws.onmessage = (e) => {
                 var d = JSON.parse(e.data);
+                if(d.ep) lastEp = d.ep;
+                if(d.seq != null) {
+                    // Snapshots restart the count, older replays are stale.
+                    // Resume only replays the newest message of each type.
+                    if(!d.snap && d.seq <= lastSeq) return;
+                    lastSeq = d.seq;
+                }
                 if(d.type == 'sensors') updSensors(d);
                 if(d.type == 'states') updStates(d);
                 if(d.type == 'settings') updSet(d);
+                if(d.type == 'forensics') updReset(d);
+                if(d.type == 'log') addLog(d);
             };
         }
 
@@ -442,6 +477,8 @@ const char index_html[] PROGMEM = R"rawliteral(
                 renSched();
             }
             if(d.d) $('dur').value = d.d;
+            if(d.wt != null) $('wt').value = d.wt;
+            if(d.cph != null) $('cal-pts').innerText = 'Points: pH ' + d.cph + ', TDS ' + d.ctds;
             if(d.nr > -1) {
                 var h = Math.floor(d.nr / 3600);
                 var m = Math.floor((d.nr % 3600) / 60);
@@ -456,6 +493,25 @@ const char index_html[] PROGMEM = R"rawliteral(
             }
         }
 
+        function updReset(d) {
+            var t = 'Last reset: ' + d.reason + ' (boot #' + d.boot + ')';
+            if(d.valid) t += ' while in "' + d.stage + '" at ' + Math.round(d.uptime / 1000) + 's uptime';
+            $('last-reset').innerText = t;
+        }
+
+        var logOn = false, logLines = [];
+        function togLog() {
+            logOn = !logOn;
+            $('log-btn').innerText = logOn ? 'Stop' : 'Start';
+            ws.send(JSON.stringify({cmd:'log', val:logOn}));
+        }
+
+        function addLog(d) {
+            logLines.push('[' + d.t + '] ' + d.lv + ' ' + d.msg);
+            if(logLines.length > 50) logLines.shift();
+            $('log').innerText = logLines.join('\n');
+        }
+
         // Navigation
         function nav(p, el) {
             document.querySelectorAll('.page').forEach(x => x.classList.remove('active'));
@@ -523,6 +579,22 @@ const char index_html[] PROGMEM = R"rawliteral(
             alert('Settings Saved');
         }
 
+        function calCap() {
+            var v = parseFloat($('cal-v').value);
+            if(isNaN(v)) return alert('Enter the reference value');
+            ws.send(JSON.stringify({cmd:'cal', s:$('cal-s').value, v:v}));
+        }
+
+        function calReset() {
+            if(confirm('Clear calibration for this probe?')) {
+                ws.send(JSON.stringify({cmd:'cal_reset', s:$('cal-s').value}));
+            }
+        }
+
+        function saveTemp() {
+            ws.send(JSON.stringify({cmd:'water_temp', val:parseFloat($('wt').value)}));
+        }
+
         function saveWifi() {
             ws.send(JSON.stringify({
                 cmd: 'save_wifi',